@@ -0,0 +1,144 @@
+#include <string.h>
+#include <math.h>
+#include "correlation.h"
+
+// k-th oldest sample in the window
+static const double *sample_at(const CorrelationEngine *engine, int k) {
+    return engine->history[(engine->start + k) % engine->window];
+}
+
+// Add (sign = 1) or remove (sign = -1) every lagged pair that has sample k as its
+// newer element (t) or its older element (t - lag)
+static void update_pairs(CorrelationEngine *engine, int k, double sign, int as_newer) {
+    const double *x = sample_at(engine, k);
+    for (int l = 0; l <= engine->max_lag; l++) {
+        int other = as_newer ? k - l : k + l;
+        if (other < 0 || other >= engine->count) continue;
+        const double *y = sample_at(engine, other);
+        const double *newer = as_newer ? x : y;
+        const double *older = as_newer ? y : x;
+        for (int a = 0; a < engine->channels; a++) {
+            for (int b = 0; b < engine->channels; b++) {
+                engine->lag_sum[l][a][b] += sign * newer[a] * older[b];
+            }
+        }
+    }
+}
+
+// Recompute the running sums exactly; done once per window to bound the floating-point
+// drift from repeated add/subtract
+static void resync(CorrelationEngine *engine) {
+    memset(engine->sum, 0, sizeof(engine->sum));
+    memset(engine->sum_sq, 0, sizeof(engine->sum_sq));
+    memset(engine->lag_sum, 0, sizeof(engine->lag_sum));
+    for (int k = 0; k < engine->count; k++) {
+        const double *x = sample_at(engine, k);
+        for (int a = 0; a < engine->channels; a++) {
+            engine->sum[a] += x[a];
+            engine->sum_sq[a] += x[a] * x[a];
+        }
+        update_pairs(engine, k, 1.0, 1);
+    }
+    engine->since_resync = 0;
+}
+
+int correlation_init(CorrelationEngine *engine, int channels, int window, int max_lag) {
+    if (channels < 1 || channels > CORR_MAX_CHANNELS ||
+        window < 2 || window > CORR_MAX_WINDOW ||
+        max_lag < 0 || max_lag > CORR_MAX_LAG || max_lag >= window) {
+        return -1;
+    }
+    engine->channels = channels;
+    engine->window = window;
+    engine->max_lag = max_lag;
+    correlation_reset(engine);
+    return 0;
+}
+
+void correlation_reset(CorrelationEngine *engine) {
+    engine->count = 0;
+    engine->start = 0;
+    engine->since_resync = 0;
+    memset(engine->sum, 0, sizeof(engine->sum));
+    memset(engine->sum_sq, 0, sizeof(engine->sum_sq));
+    memset(engine->lag_sum, 0, sizeof(engine->lag_sum));
+}
+
+void correlation_append(CorrelationEngine *engine, const float *sample) {
+    // Evict the oldest sample and every pair it takes part in
+    if (engine->count == engine->window) {
+        const double *oldest = sample_at(engine, 0);
+        update_pairs(engine, 0, -1.0, 0);
+        for (int a = 0; a < engine->channels; a++) {
+            engine->sum[a] -= oldest[a];
+            engine->sum_sq[a] -= oldest[a] * oldest[a];
+        }
+        engine->start = (engine->start + 1) % engine->window;
+        engine->count--;
+    }
+
+    double *x = engine->history[(engine->start + engine->count) % engine->window];
+    for (int a = 0; a < engine->channels; a++) {
+        x[a] = sample[a];
+        engine->sum[a] += x[a];
+        engine->sum_sq[a] += x[a] * x[a];
+    }
+    engine->count++;
+    update_pairs(engine, engine->count - 1, 1.0, 1);
+
+    if (++engine->since_resync >= engine->window) {
+        resync(engine);
+    }
+}
+
+float correlation_lagged(const CorrelationEngine *engine, int a, int b, int lag) {
+    if (lag < 0) return correlation_lagged(engine, b, a, -lag);
+
+    int n = engine->count;
+    if (lag > engine->max_lag || n - lag < 2) return 0;
+
+    double mean_a = engine->sum[a] / n;
+    double mean_b = engine->sum[b] / n;
+    double var_a = engine->sum_sq[a] / n - mean_a * mean_a;
+    double var_b = engine->sum_sq[b] / n - mean_b * mean_b;
+    if (var_a <= 0 || var_b <= 0) return 0;
+
+    // Sums of a over t in [lag, n) and of b over t - lag in [0, n - lag)
+    double sum_a = engine->sum[a];
+    double sum_b = engine->sum[b];
+    for (int k = 0; k < lag; k++) {
+        sum_a -= sample_at(engine, k)[a];
+        sum_b -= sample_at(engine, n - 1 - k)[b];
+    }
+
+    // Biased (divide by n) estimator, identical to Pearson's r at lag 0
+    double co_moment = engine->lag_sum[lag][a][b] - mean_b * sum_a - mean_a * sum_b
+                     + (n - lag) * mean_a * mean_b;
+    double r = co_moment / n / sqrt(var_a * var_b);
+    if (r > 1) r = 1;
+    if (r < -1) r = -1;
+    return (float)r;
+}
+
+float correlation_coefficient(const CorrelationEngine *engine, int a, int b) {
+    return correlation_lagged(engine, a, b, 0);
+}
+
+int correlation_best_lag(const CorrelationEngine *engine, int a, int b, float *coefficient) {
+    int best_lag = 0;
+    float best = correlation_lagged(engine, a, b, 0);
+    for (int l = 1; l <= engine->max_lag; l++) {
+        float forward = correlation_lagged(engine, a, b, l);
+        float backward = correlation_lagged(engine, a, b, -l);
+        if (fabsf(forward) > fabsf(best)) {
+            best = forward;
+            best_lag = l;
+        }
+        if (fabsf(backward) > fabsf(best)) {
+            best = backward;
+            best_lag = -l;
+        }
+    }
+    if (coefficient) *coefficient = best;
+    return best_lag;
+}
@@ -0,0 +1,44 @@
+#ifndef CORRELATION_H
+#define CORRELATION_H
+
+// Sliding-window correlation engine. Keeps running sums, sums of squares and lagged
+// co-moment sums for every channel pair, updated on append/eviction, so the correlation
+// matrix and bounded-lag cross-correlation cost O(channels^2 * lags) per update instead
+// of O(channels^2 * window).
+#define CORR_MAX_CHANNELS 12        // e.g. several devices x temperature/humidity/illuminance
+#define CORR_MAX_WINDOW 512
+#define CORR_MAX_LAG 16
+
+typedef struct {
+    int channels;
+    int window;                     // Window length in samples
+    int max_lag;                    // Lags 0..max_lag are tracked in both directions
+    int count;                      // Samples currently in the window
+    int start;                      // Ring index of the oldest sample
+    int since_resync;               // Appends since sums were last recomputed exactly
+    double history[CORR_MAX_WINDOW][CORR_MAX_CHANNELS];
+    double sum[CORR_MAX_CHANNELS];
+    double sum_sq[CORR_MAX_CHANNELS];
+    // lag_sum[l][a][b] = sum over the window of x_a(t) * x_b(t - l)
+    double lag_sum[CORR_MAX_LAG + 1][CORR_MAX_CHANNELS][CORR_MAX_CHANNELS];
+} CorrelationEngine;
+
+// Returns 0 on success, -1 if a dimension exceeds the compile-time limits
+int correlation_init(CorrelationEngine *engine, int channels, int window, int max_lag);
+
+// Drop all samples, keeping the dimensions
+void correlation_reset(CorrelationEngine *engine);
+
+// Push one sample (one value per channel), evicting the oldest once the window is full
+void correlation_append(CorrelationEngine *engine, const float *sample);
+
+// Pearson correlation of channels a and b over the window (0 if undefined)
+float correlation_coefficient(const CorrelationEngine *engine, int a, int b);
+
+// Correlation of a(t) with b(t - lag); a negative lag correlates b(t) with a(t + lag)
+float correlation_lagged(const CorrelationEngine *engine, int a, int b, int lag);
+
+// Lag in [-max_lag, max_lag] with the strongest |correlation|; stores it in *coefficient
+int correlation_best_lag(const CorrelationEngine *engine, int a, int b, float *coefficient);
+
+#endif
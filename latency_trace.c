@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <time.h>
+#include "latency_trace.h"
+
+long long trace_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+int trace_has_column(sqlite3 *db, const char *column) {
+    sqlite3_stmt *stmt;
+    int found = 0;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA table_info(sensor_readings);", -1, &stmt, 0) != SQLITE_OK) {
+        return 0;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (strcmp((const char *)sqlite3_column_text(stmt, 1), column) == 0) found = 1;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+int trace_columns_available(sqlite3 *db) {
+    return trace_has_column(db, "seq") && trace_has_column(db, "gen_time_us") &&
+           trace_has_column(db, "insert_time_us");
+}
+
+void trace_init(LatencyTrace *trace) {
+    memset(trace, 0, sizeof(*trace));
+    sketch_init(&trace->gen_to_insert);
+    sketch_init(&trace->insert_to_load);
+    sketch_init(&trace->load_to_draw);
+    sketch_init(&trace->gen_to_draw);
+}
+
+void trace_loaded(LatencyTrace *trace, long long seq, long long gen_us, long long insert_us) {
+    if (trace->last_seq > 0 && seq > trace->last_seq + 1) {
+        trace->seq_gaps += seq - trace->last_seq - 1;
+    }
+    if (seq > trace->last_seq) trace->last_seq = seq;
+
+    if (trace->pending_count >= TRACE_MAX_PENDING) {
+        trace->dropped++;
+        return;
+    }
+    PendingTrace *p = &trace->pending[trace->pending_count++];
+    p->seq = seq;
+    p->gen_us = gen_us;
+    p->insert_us = insert_us;
+    p->load_us = trace_now_us();
+}
+
+void trace_presented(LatencyTrace *trace) {
+    if (trace->pending_count == 0) return;
+
+    long long draw_us = trace_now_us();
+    for (int i = 0; i < trace->pending_count; i++) {
+        const PendingTrace *p = &trace->pending[i];
+        sketch_add(&trace->gen_to_insert, (p->insert_us - p->gen_us) / 1000.0f);
+        sketch_add(&trace->insert_to_load, (p->load_us - p->insert_us) / 1000.0f);
+        sketch_add(&trace->load_to_draw, (draw_us - p->load_us) / 1000.0f);
+        sketch_add(&trace->gen_to_draw, (draw_us - p->gen_us) / 1000.0f);
+    }
+    trace->traced += trace->pending_count;
+    trace->pending_count = 0;
+}
+
+float trace_gen_to_draw_ms(const LatencyTrace *trace, float q) {
+    return sketch_quantile(&trace->gen_to_draw, q);
+}
+
+static void report_stage(FILE *out, const char *name, const QuantileSketch *sketch) {
+    fprintf(out, "  %-16s p50 %9.1f ms   p95 %9.1f ms   p99 %9.1f ms\n", name,
+            sketch_quantile(sketch, 0.50f), sketch_quantile(sketch, 0.95f), sketch_quantile(sketch, 0.99f));
+}
+
+void trace_report(const LatencyTrace *trace, FILE *out) {
+    if (trace->traced == 0) return;
+
+    fprintf(out, "Latency over %lld readings (%lld untraced, %lld missing from sequence):\n",
+            trace->traced, trace->dropped, trace->seq_gaps);
+    report_stage(out, "generate->insert", &trace->gen_to_insert);
+    report_stage(out, "insert->load", &trace->insert_to_load);
+    report_stage(out, "load->draw", &trace->load_to_draw);
+    report_stage(out, "generate->draw", &trace->gen_to_draw);
+}
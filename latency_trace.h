@@ -0,0 +1,55 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdio.h>
+#include <sqlite3.h>
+#include "quantile_sketch.h"
+
+// Readings loaded but not yet presented on screen
+#define TRACE_MAX_PENDING 256
+
+typedef struct {
+    long long seq;
+    long long gen_us;               // Generated by the simulator
+    long long insert_us;            // Insert into SQLite started (before its commit)
+    long long load_us;              // Fetched by the visualizer
+} PendingTrace;
+
+// Ingest-to-display latency, per stage, in milliseconds
+typedef struct {
+    QuantileSketch gen_to_insert;
+    QuantileSketch insert_to_load;
+    QuantileSketch load_to_draw;
+    QuantileSketch gen_to_draw;
+    PendingTrace pending[TRACE_MAX_PENDING];
+    int pending_count;
+    long long traced;               // Readings traced through to the screen
+    long long dropped;              // Readings not traced because the pending list was full
+    long long seq_gaps;             // Readings missing from the sequence
+    long long last_seq;
+} LatencyTrace;
+
+// Wall-clock time in microseconds, comparable across processes on the same host. The
+// simulator and writer stamp readings with it too.
+long long trace_now_us(void);
+
+// Returns 1 if sensor_readings has the named column
+int trace_has_column(sqlite3 *db, const char *column);
+
+// Returns 1 if sensor_readings has the seq/gen_time_us/insert_time_us columns
+int trace_columns_available(sqlite3 *db);
+
+void trace_init(LatencyTrace *trace);
+
+// A reading was fetched from the database (stamps the load time)
+void trace_loaded(LatencyTrace *trace, long long seq, long long gen_us, long long insert_us);
+
+// Call right after EndDrawing: everything loaded so far is now visible
+void trace_presented(LatencyTrace *trace);
+
+// Median and 99th percentile of generation-to-screen latency in milliseconds
+float trace_gen_to_draw_ms(const LatencyTrace *trace, float q);
+
+void trace_report(const LatencyTrace *trace, FILE *out);
+
+#endif
@@ -0,0 +1,140 @@
+#include <string.h>
+#include <math.h>
+#include "quantile_sketch.h"
+
+// Bucket i holds magnitudes in (SKETCH_MIN_VALUE * gamma^(i-1), SKETCH_MIN_VALUE * gamma^i]
+static double sketch_gamma(void) {
+    return (1.0 + SKETCH_RELATIVE_ACCURACY) / (1.0 - SKETCH_RELATIVE_ACCURACY);
+}
+
+static int bucket_index(double magnitude) {
+    static double log_gamma = 0;
+    if (log_gamma == 0) log_gamma = log(sketch_gamma());
+
+    int index = (int)ceil(log(magnitude / SKETCH_MIN_VALUE) / log_gamma);
+    if (index < 0) index = 0;
+    if (index >= SKETCH_BUCKETS) index = SKETCH_BUCKETS - 1;
+    return index;
+}
+
+// Midpoint (in relative terms) of a bucket, which bounds the error on both sides
+static double bucket_value(int index) {
+    double gamma = sketch_gamma();
+    return SKETCH_MIN_VALUE * pow(gamma, index) * 2.0 / (gamma + 1.0);
+}
+
+static uint32_t *bucket_for(QuantileSketch *sketch, float value) {
+    if (fabsf(value) < SKETCH_MIN_VALUE) return &sketch->zero;
+    if (value > 0) return &sketch->positive[bucket_index(value)];
+    return &sketch->negative[bucket_index(-value)];
+}
+
+void sketch_init(QuantileSketch *sketch) {
+    memset(sketch, 0, sizeof(*sketch));
+}
+
+void sketch_add(QuantileSketch *sketch, float value) {
+    (*bucket_for(sketch, value))++;
+    sketch->count++;
+}
+
+void sketch_remove(QuantileSketch *sketch, float value) {
+    uint32_t *bucket = bucket_for(sketch, value);
+    if (*bucket == 0) return;
+    (*bucket)--;
+    sketch->count--;
+}
+
+void sketch_merge(QuantileSketch *dst, const QuantileSketch *src) {
+    if (src->count == 0) return;
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        dst->positive[i] += src->positive[i];
+        dst->negative[i] += src->negative[i];
+    }
+    dst->zero += src->zero;
+    dst->count += src->count;
+}
+
+float sketch_quantile(const QuantileSketch *sketch, float q) {
+    if (sketch->count == 0) return 0;
+    if (q < 0) q = 0;
+    if (q > 1) q = 1;
+
+    uint32_t rank = (uint32_t)(q * (sketch->count - 1));
+    uint32_t seen = 0;
+
+    // Walk buckets in ascending value order: large negatives, zero, then positives
+    for (int i = SKETCH_BUCKETS - 1; i >= 0; i--) {
+        seen += sketch->negative[i];
+        if (seen > rank) return (float)-bucket_value(i);
+    }
+    seen += sketch->zero;
+    if (seen > rank) return 0;
+    for (int i = 0; i < SKETCH_BUCKETS; i++) {
+        seen += sketch->positive[i];
+        if (seen > rank) return (float)bucket_value(i);
+    }
+    return (float)bucket_value(SKETCH_BUCKETS - 1);
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; p[2] = (v >> 16) & 0xff; p[3] = v >> 24;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Layout: count, zero, entry count, then (bucket, count) entries where buckets
+// SKETCH_BUCKETS and up are the negative side
+int sketch_encode(const QuantileSketch *sketch, unsigned char *buf, int capacity) {
+    int size = 12;
+    uint32_t entries = 0;
+
+    for (int i = 0; i < 2 * SKETCH_BUCKETS; i++) {
+        uint32_t n = i < SKETCH_BUCKETS ? sketch->positive[i] : sketch->negative[i - SKETCH_BUCKETS];
+        if (n == 0) continue;
+        if (size + 6 > capacity) return -1;
+        buf[size] = i & 0xff;
+        buf[size + 1] = i >> 8;
+        put_u32(&buf[size + 2], n);
+        size += 6;
+        entries++;
+    }
+    if (capacity < 12) return -1;
+    put_u32(&buf[0], sketch->count);
+    put_u32(&buf[4], sketch->zero);
+    put_u32(&buf[8], entries);
+    return size;
+}
+
+int sketch_decode(QuantileSketch *sketch, const unsigned char *buf, int size) {
+    sketch_init(sketch);
+    if (size < 12) return -1;
+
+    uint32_t entries = get_u32(&buf[8]);
+    if (entries > 2 * SKETCH_BUCKETS || size != 12 + 6 * (int)entries) return -1;
+
+    uint64_t total = get_u32(&buf[4]);
+    for (uint32_t e = 0; e < entries; e++) {
+        const unsigned char *p = &buf[12 + 6 * e];
+        int i = p[0] | p[1] << 8;
+        if (i >= 2 * SKETCH_BUCKETS) {
+            sketch_init(sketch);
+            return -1;
+        }
+        uint32_t n = get_u32(&p[2]);
+        if (i < SKETCH_BUCKETS) sketch->positive[i] += n;
+        else sketch->negative[i - SKETCH_BUCKETS] += n;
+        total += n;
+    }
+    sketch->zero = get_u32(&buf[4]);
+    sketch->count = get_u32(&buf[0]);
+
+    // Every counted value must be in some bucket
+    if (total != sketch->count) {
+        sketch_init(sketch);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <stdint.h>
+
+// Log-bucketed histogram: every value is counted in a bucket whose bounds grow by a
+// constant factor, so quantiles are answered within SKETCH_RELATIVE_ACCURACY of the true
+// value using fixed memory. Sketches are mergeable (add bucket counts) and, because they
+// only hold counts, values can also be removed again to maintain sliding windows.
+#define SKETCH_BUCKETS 1024
+#define SKETCH_RELATIVE_ACCURACY 0.01
+#define SKETCH_MIN_VALUE 1e-3       // Magnitudes below this are counted as zero
+
+// Encoded size: 12-byte header plus 6 bytes per non-empty bucket
+#define SKETCH_MAX_ENCODED_SIZE (12 + 6 * 2 * SKETCH_BUCKETS)
+
+typedef struct {
+    uint32_t positive[SKETCH_BUCKETS];
+    uint32_t negative[SKETCH_BUCKETS];
+    uint32_t zero;
+    uint32_t count;
+} QuantileSketch;
+
+void sketch_init(QuantileSketch *sketch);
+void sketch_add(QuantileSketch *sketch, float value);
+
+// Remove a value previously added with sketch_add
+void sketch_remove(QuantileSketch *sketch, float value);
+
+// Accumulate `src` into `dst`
+void sketch_merge(QuantileSketch *dst, const QuantileSketch *src);
+
+// Value at quantile q in [0, 1]; returns 0 for an empty sketch
+float sketch_quantile(const QuantileSketch *sketch, float q);
+
+// Compact little-endian encoding for storage: only non-empty buckets are written.
+// Returns the number of bytes written to `buf`, or -1 if `capacity` is too small.
+int sketch_encode(const QuantileSketch *sketch, unsigned char *buf, int capacity);
+
+// Returns 0, or -1 (leaving an empty sketch) if `buf` isn't a valid encoding
+int sketch_decode(QuantileSketch *sketch, const unsigned char *buf, int size);
+
+#endif
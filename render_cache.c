@@ -0,0 +1,80 @@
+#include <rlgl.h>
+#include "render_cache.h"
+
+// Render textures are stored bottom-up, so they are drawn with a negative source height
+static void draw_texture_flipped(Texture2D texture, Vector2 position) {
+    Rectangle source = { 0, 0, (float)texture.width, -(float)texture.height };
+    DrawTextureRec(texture, source, position, WHITE);
+}
+
+// Panel textures hold premultiplied colour. Drawing blends colour as usual but keeps the
+// destination's coverage in alpha (dst alpha factor ONE_MINUS_SRC_ALPHA on top of src ONE),
+// so translucent draws don't punch holes in an opaque background; the texture is then
+// composited with premultiplied blending and looks exactly like drawing straight to screen.
+static void begin_panel_blending(void) {
+    rlSetBlendFactorsSeparate(RL_SRC_ALPHA, RL_ONE_MINUS_SRC_ALPHA, RL_ONE, RL_ONE_MINUS_SRC_ALPHA,
+                              RL_FUNC_ADD, RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM_SEPARATE);
+}
+
+static void draw_texture_premultiplied(Texture2D texture, Vector2 position) {
+    BeginBlendMode(BLEND_ALPHA_PREMULTIPLY);
+    draw_texture_flipped(texture, position);
+    EndBlendMode();
+}
+
+// Map screen coordinates onto the panel's texture so the usual drawing code can be reused
+static void begin_panel_space(const CachedPanel *panel) {
+    Camera2D camera = { 0 };
+    camera.target = (Vector2){ panel->bounds.x, panel->bounds.y };
+    camera.zoom = 1.0f;
+    BeginMode2D(camera);
+}
+
+void panel_init(CachedPanel *panel, Rectangle bounds) {
+    panel->bounds = bounds;
+    panel->chrome = LoadRenderTexture((int)bounds.width, (int)bounds.height);
+    panel->layer = LoadRenderTexture((int)bounds.width, (int)bounds.height);
+    panel->chrome_dirty = 1;
+    panel->layer_dirty = 1;
+}
+
+void panel_unload(CachedPanel *panel) {
+    UnloadRenderTexture(panel->chrome);
+    UnloadRenderTexture(panel->layer);
+}
+
+void panel_begin_chrome(CachedPanel *panel, Color background) {
+    BeginTextureMode(panel->chrome);
+    ClearBackground(background);
+    begin_panel_blending();
+    begin_panel_space(panel);
+}
+
+void panel_begin_layer(CachedPanel *panel) {
+    BeginTextureMode(panel->layer);
+    ClearBackground(BLANK);
+    draw_texture_premultiplied(panel->chrome.texture, (Vector2){ 0, 0 });
+    begin_panel_blending();
+    begin_panel_space(panel);
+}
+
+void panel_end_chrome(CachedPanel *panel) {
+    EndMode2D();
+    EndBlendMode();
+    EndTextureMode();
+    panel->chrome_dirty = 0;
+    // The data layer is built on top of the chrome
+    panel->layer_dirty = 1;
+}
+
+void panel_end_layer(CachedPanel *panel) {
+    EndMode2D();
+    EndBlendMode();
+    EndTextureMode();
+    panel->layer_dirty = 0;
+}
+
+void panel_draw(const CachedPanel *panel) {
+    draw_texture_premultiplied(panel->layer.texture, (Vector2){ panel->bounds.x, panel->bounds.y });
+}
@@ -0,0 +1,33 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include <raylib.h>
+
+// A screen region rendered through two cached layers: `chrome` holds what only changes
+// with the axis ranges or view (background, grid, labels), `layer` is the chrome plus the
+// plotted data. Each is re-rendered only when marked dirty; every frame just blits `layer`.
+typedef struct {
+    Rectangle bounds;               // Screen area covered by the panel
+    RenderTexture2D chrome;
+    RenderTexture2D layer;
+    int chrome_dirty;
+    int layer_dirty;
+} CachedPanel;
+
+// Allocate the textures (requires an open window); both layers start dirty
+void panel_init(CachedPanel *panel, Rectangle bounds);
+void panel_unload(CachedPanel *panel);
+
+// Draw into the chrome texture using screen coordinates, cleared to `background`.
+// Ending the chrome marks the data layer dirty, since it is built on top of it.
+void panel_begin_chrome(CachedPanel *panel, Color background);
+void panel_end_chrome(CachedPanel *panel);
+
+// Draw into the data layer using screen coordinates, starting from a copy of the chrome
+void panel_begin_layer(CachedPanel *panel);
+void panel_end_layer(CachedPanel *panel);
+
+// Blit the data layer to the screen (premultiplied alpha)
+void panel_draw(const CachedPanel *panel);
+
+#endif
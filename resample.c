@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "resample.h"
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Median spacing between consecutive readings (over the newest RESAMPLE_MAX_BINS),
+// robust to the odd burst or outage; 0 if there is no positive spacing
+static double typical_interval(const SensorReading *readings, int count) {
+    double intervals[RESAMPLE_MAX_BINS];
+    int n = 0;
+
+    for (int i = count - 1; i > 0 && n < RESAMPLE_MAX_BINS; i--) {
+        double dt = sensor_reading_time(&readings[i]) - sensor_reading_time(&readings[i-1]);
+        if (dt > 0) intervals[n++] = dt;
+    }
+    if (n == 0) return 0;
+
+    qsort(intervals, n, sizeof(double), compare_doubles);
+    return intervals[n / 2];
+}
+
+void resample_default_config(ResampleConfig *config) {
+    config->step = 0;
+    config->max_bins = RESAMPLE_MAX_BINS;
+    config->max_gap = 0;
+    config->aggregate = RESAMPLE_MEAN;
+    config->interpolation = RESAMPLE_INTERP_LINEAR;
+}
+
+// Fill the empty bins strictly between observed bins `before` and `after`
+static void fill_run(ResampledGrid *grid, int before, int after, ResampleInterpolation interpolation) {
+    if (interpolation == RESAMPLE_INTERP_NONE) return;
+
+    for (int i = before + 1; i < after; i++) {
+        float t = (float)(i - before) / (after - before);
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            float a = grid->values[c][before], b = grid->values[c][after];
+            grid->values[c][i] = interpolation == RESAMPLE_INTERP_HOLD ? a : a + (b - a) * t;
+        }
+        grid->mask[i] = RESAMPLE_FILLED;
+    }
+}
+
+int resample_readings(const SensorReading *readings, int count, const ResampleConfig *config,
+                      ResampledGrid *grid) {
+    memset(grid->values, 0, sizeof(grid->values));
+    memset(grid->mask, RESAMPLE_EMPTY, sizeof(grid->mask));
+    grid->bins = grid->padded_bins = grid->gap_count = 0;
+    grid->start = grid->step = 0;
+    if (count <= 0) return 0;
+
+    int max_bins = config->max_bins;
+    if (max_bins < 2 || max_bins > RESAMPLE_MAX_BINS) max_bins = RESAMPLE_MAX_BINS;
+
+    // Step: requested or the typical interval, widened until the window fits in max_bins
+    double typical = typical_interval(readings, count);
+    double span = sensor_reading_time(&readings[count-1]) - sensor_reading_time(&readings[0]);
+    double step = config->step > 0 ? config->step : typical;
+    if (span > 0 && (step <= 0 || span / step + 1 > max_bins)) step = span / (max_bins - 1);
+    if (step <= 0) step = 1.0;
+
+    grid->start = sensor_reading_time(&readings[0]);
+    grid->step = step;
+    grid->bins = span > 0 ? (int)floor(span / step + 0.5) + 1 : 1;
+    if (grid->bins > max_bins) grid->bins = max_bins;
+    grid->padded_bins = (grid->bins + RESAMPLE_LANES - 1) / RESAMPLE_LANES * RESAMPLE_LANES;
+
+    // Aggregate readings into their bins
+    int hits[RESAMPLE_MAX_BINS] = {0};
+    for (int i = 0; i < count; i++) {
+        int bin = (int)floor((sensor_reading_time(&readings[i]) - grid->start) / step + 0.5);
+        if (bin < 0) bin = 0;
+        if (bin >= grid->bins) bin = grid->bins - 1;
+
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            float v = sensor_channel_value(&readings[i], c);
+            float *slot = &grid->values[c][bin];
+            if (hits[bin] == 0) {
+                *slot = v;
+                continue;
+            }
+            switch (config->aggregate) {
+                case RESAMPLE_MEAN: *slot += v; break;
+                case RESAMPLE_LAST: *slot = v; break;
+                case RESAMPLE_MIN: if (v < *slot) *slot = v; break;
+                case RESAMPLE_MAX: if (v > *slot) *slot = v; break;
+                default: break;
+            }
+        }
+        hits[bin]++;
+    }
+    for (int b = 0; b < grid->bins; b++) {
+        if (hits[b] == 0) continue;
+        grid->mask[b] = RESAMPLE_OBSERVED;
+        if (config->aggregate == RESAMPLE_MEAN && hits[b] > 1) {
+            for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+                grid->values[c][b] /= hits[b];
+            }
+        }
+    }
+
+    // Empty runs: a silence longer than max_gap is a gap, anything shorter is interpolated.
+    // The first and last bins always hold a reading, so every run has both neighbours.
+    double max_gap = config->max_gap > 0 ? config->max_gap
+                                         : RESAMPLE_GAP_FACTOR * (typical > step ? typical : step);
+    int before = 0;
+    for (int b = 1; b < grid->bins; b++) {
+        if (hits[b] == 0) continue;
+        if (b > before + 1) {
+            if ((b - before) * step > max_gap) {
+                memset(&grid->mask[before + 1], RESAMPLE_GAP, b - before - 1);
+                grid->gap_count++;
+            } else {
+                fill_run(grid, before, b, config->interpolation);
+            }
+        }
+        before = b;
+    }
+
+    return grid->bins;
+}
+
+const char *resample_aggregate_name(ResampleAggregate aggregate) {
+    switch (aggregate) {
+        case RESAMPLE_MEAN: return "mean";
+        case RESAMPLE_LAST: return "last";
+        case RESAMPLE_MIN: return "min";
+        case RESAMPLE_MAX: return "max";
+        default: return "?";
+    }
+}
+
+const char *resample_interpolation_name(ResampleInterpolation interpolation) {
+    switch (interpolation) {
+        case RESAMPLE_INTERP_LINEAR: return "linear";
+        case RESAMPLE_INTERP_HOLD: return "hold";
+        case RESAMPLE_INTERP_NONE: return "none";
+        default: return "?";
+    }
+}
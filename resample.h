@@ -0,0 +1,76 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "sensor_reading.h"
+
+// Maps readings onto a fixed-step time grid so plots and per-window kernels see evenly
+// spaced samples. Bin i is centred on start + i * step; each bin carries a mask entry
+// saying whether it was observed, filled in, or lies inside a gap. Readings are placed at
+// sensor_reading_time(), i.e. their generation time where the database recorded it.
+#define RESAMPLE_MAX_BINS 512
+#define RESAMPLE_LANES 8                // Channel arrays are padded to a multiple of this
+#define RESAMPLE_ALIGNMENT 32           // Bytes; one 8-float vector
+#define RESAMPLE_GAP_FACTOR 3.0         // Default gap: silence longer than 3 typical intervals
+
+typedef enum {
+    RESAMPLE_MEAN,
+    RESAMPLE_LAST,
+    RESAMPLE_MIN,
+    RESAMPLE_MAX,
+    RESAMPLE_AGGREGATE_COUNT
+} ResampleAggregate;                    // How readings falling into one bin are combined
+
+typedef enum {
+    RESAMPLE_INTERP_LINEAR,
+    RESAMPLE_INTERP_HOLD,
+    RESAMPLE_INTERP_NONE,
+    RESAMPLE_INTERP_COUNT
+} ResampleInterpolation;                // How empty bins between close readings are filled
+
+typedef enum {
+    RESAMPLE_EMPTY = 0,                 // No reading and not filled (also the padding)
+    RESAMPLE_OBSERVED,                  // At least one reading
+    RESAMPLE_FILLED,                    // Interpolated from neighbouring bins
+    RESAMPLE_GAP                        // Inside a stretch with no data; plots break here
+} ResampleMask;
+
+typedef struct {
+    double step;                        // Seconds per bin; 0 picks the typical reading interval
+    int max_bins;                       // Upper bound on bins (<= RESAMPLE_MAX_BINS); step grows to fit
+    double max_gap;                     // Longer silences are gaps; 0 uses RESAMPLE_GAP_FACTOR
+    ResampleAggregate aggregate;
+    ResampleInterpolation interpolation;
+} ResampleConfig;
+
+typedef struct {
+    double start;                       // Centre of bin 0 (the first reading's time)
+    double step;
+    int bins;
+    int padded_bins;                    // bins rounded up to RESAMPLE_LANES
+    int gap_count;                      // Separate gaps found
+    // Zero outside observed/filled bins, including the padding, so kernels can run
+    // whole vectors over padded_bins and weight by the mask
+    float values[SENSOR_CHANNEL_COUNT][RESAMPLE_MAX_BINS] __attribute__((aligned(RESAMPLE_ALIGNMENT)));
+    unsigned char mask[RESAMPLE_MAX_BINS];
+} ResampledGrid;
+
+// Defaults: automatic step and gap threshold, mean aggregation, linear interpolation
+void resample_default_config(ResampleConfig *config);
+
+// Resample `count` readings (oldest first). Returns the number of bins.
+int resample_readings(const SensorReading *readings, int count, const ResampleConfig *config,
+                      ResampledGrid *grid);
+
+static inline double resample_bin_time(const ResampledGrid *grid, int bin) {
+    return grid->start + bin * grid->step;
+}
+
+// Bins with a value to plot or compute on
+static inline int resample_has_value(const ResampledGrid *grid, int bin) {
+    return grid->mask[bin] == RESAMPLE_OBSERVED || grid->mask[bin] == RESAMPLE_FILLED;
+}
+
+const char *resample_aggregate_name(ResampleAggregate aggregate);
+const char *resample_interpolation_name(ResampleInterpolation interpolation);
+
+#endif
@@ -5,9 +5,17 @@
 #include <math.h>
 #include <gsl/gsl_statistics_float.h>
 #include <gsl/gsl_fit.h>
-#include <gsl/gsl_sort.h>
 #include <gsl/gsl_math.h>
 #include <raylib.h>
+#include "sensor_reading.h"
+#include "sensor_snapshot.h"
+#include "quantile_sketch.h"
+#include "sensor_rollup.h"
+#include "sliding_dft.h"
+#include "correlation.h"
+#include "render_cache.h"
+#include "latency_trace.h"
+#include "resample.h"
 
 // Configuration
 #define MAX_READINGS 500
@@ -22,30 +30,88 @@
 #define Y_LABEL_WIDTH 20
 #define MOVING_AVG_WINDOW 7
 #define TREND_POLY_DEGREE 2
-
-typedef struct {
-    double timestamp;
-    float temperature;
-    float humidity;
-    float illuminance;
-} SensorReading;
+#define LOAD_BATCH_SIZE 64      // Max rows fetched per frame while catching up
+#define SNAPSHOT_PATH "sensor_gsl_visualizer.snap"
+#define SNAPSHOT_INTERVAL 30.0  // Seconds between periodic snapshot saves
+#define TRACE_REPORT_INTERVAL 60.0  // Seconds between latency reports on stdout
+#define ROLLUP_REFRESH_INTERVAL 5.0  // Seconds between reads of the writer's rollups
+#define SPECTRUM_MIN_WINDOW 32
+#define SPECTRUM_DEFAULT_WINDOW 128
+#define SPECTRUM_MAX_JITTER 0.5 // Intervals within 50% of the nominal interval count as even
+#define SPECTRUM_MAX_UNEVEN 0.1 // Fraction of uneven intervals the sliding DFTs tolerate (scheduling jitter)
+#define CORRELATION_MAX_LAG 12  // Cross-correlation lags tracked, in samples
+#define ACTIVE_FPS 30           // Frame rate right after something changed
+#define IDLE_FPS 10             // Frame rate while nothing changes
+#define ACTIVE_PERIOD 1.0       // Seconds to stay at ACTIVE_FPS after a change
+#define HELP_TEXT "F: spectrum  UP/DOWN: window  C: correlation  A/I: resampling"
 
 // Global variables
 SensorReading readings[MAX_READINGS];
 int reading_count = 0;
-double last_reading_timestamp = 0;
+long long last_reading_id = 0;      // Cursor: highest sensor_readings.id in the window
+long long saved_reading_id = 0;     // Cursor stored in the last snapshot written
+unsigned int data_version = 0;      // Bumped whenever the readings change
+
+// Generation-to-screen latency of readings appended while running
+LatencyTrace latency;
+int trace_enabled = 0;              // Database has the seq/gen_time_us/insert_time_us columns
 sqlite3 *db = NULL;
 
+// Quantile sketches: the displayed window is maintained by add/remove, the long window is
+// answered by merging the rollup buckets the writer stores in sensor_rollups
+QuantileSketch window_sketches[SENSOR_CHANNEL_COUNT];
+QuantileSketch long_window_sketches[SENSOR_CHANNEL_COUNT];
+RollupBucket rollups[ROLLUP_BUCKETS];
+long long rollup_newest_start = 0;  // Newest bucket loaded; later loads start from it
+double long_window_hours = 0;       // Span the merged buckets cover; 0 if there are none
+int rollups_dirty = 0;
+
+// Per-channel spectra over the newest spectrum_window readings. They assume evenly spaced
+// readings; when the spacing is uneven the spectrum is taken from a uniform grid instead.
+SlidingDft spectra[SENSOR_CHANNEL_COUNT];
+SlidingDft grid_spectra[SENSOR_CHANNEL_COUNT];
+ResampledGrid spectrum_grid;
+int spectrum_window = SPECTRUM_DEFAULT_WINDOW;
+int spectra_seeded = 0;
+int spectrum_from_grid = 0;         // Showing grid_spectra rather than spectra
+double spectrum_nominal = 0;        // Median interval when the spectra were seeded
+int spectrum_uneven = 0;            // Intervals in the spectrum window outside SPECTRUM_MAX_JITTER of nominal
+int spectrum_gaps = 0;              // Of those, intervals long enough to be a gap in the data
+double spectrum_interval = 0;       // Seconds between spectrum samples; 0 if no valid spectrum
+char spectrum_status[96] = "";      // Why there is no valid spectrum
+int show_spectrum = 0;
+
+// Channel-pair correlation over the displayed window
+CorrelationEngine correlation;
+int show_correlation = 0;
+
+// The window on a uniform time grid for plotting; A cycles the aggregation, I the interpolation
+ResampleConfig plot_config;
+ResampledGrid plot_grid;
+
 // Function prototypes
-void load_sensor_data();
-void draw_graph(const char* title, float *values, int count, int graph_index, 
+int load_sensor_data();
+int load_rollups();
+void refresh_long_window_sketches();
+void save_snapshot();
+void seed_spectra();
+void prepare_spectra();
+void rebuild_window_analysis();
+void compute_ranges(float *min_vals, float *max_vals);
+void draw_graph_chrome(const char* title, int graph_index, float min_val, float max_val, Color color);
+void draw_graph(float *values, int count, const ResampledGrid *grid, int graph_index,
                 float min_val, float max_val, Color color);
-void draw_statistics(float x, float y, float mean, float median, float sd, float min, float max, Color color);
+void draw_statistics(float x, float y, float mean, float sd, float min, float max,
+                     const float *window_q, const float *long_q, Color color);
+void draw_spectrum_chrome(const char* title, int graph_index, Color color);
+void draw_spectrum(int graph_index, Color color);
+void draw_correlation(float x, float y);
+void draw_latency(float right, float y);
 
 int main() {
     // Initialize window
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Sensor Data Visualizer with GSL Analysis");
-    SetTargetFPS(30);
+    SetTargetFPS(ACTIVE_FPS);
 
     // Open database
     int rc = sqlite3_open_v2("sensor_data.db", &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX, NULL);
@@ -54,58 +120,177 @@ int main() {
         return 1;
     }
 
+    correlation_init(&correlation, SENSOR_CHANNEL_COUNT, MAX_READINGS, CORRELATION_MAX_LAG);
+    trace_init(&latency);
+    trace_enabled = trace_columns_available(db);
+    resample_default_config(&plot_config);
+
+    // Restore the last window from the snapshot so the first frame doesn't wait on SQLite
+    SnapshotInfo snapshot;
+    int restored = snapshot_load(SNAPSHOT_PATH, readings, MAX_READINGS, &snapshot);
+    if (restored > 0 && !snapshot_matches_database(db, snapshot.last_id, &readings[restored - 1])) {
+        printf("Snapshot doesn't match the database, loading from scratch.\n");
+        restored = 0;
+    }
+    if (restored > 0) {
+        reading_count = restored;
+        last_reading_id = saved_reading_id = snapshot.last_id;
+        printf("Warm start: %d readings from snapshot (cursor id %lld).\n", reading_count, last_reading_id);
+        rebuild_window_analysis();
+    }
+    double last_snapshot = GetTime();
+    double last_trace_report = last_snapshot;
+    load_rollups();
+    double last_rollup_refresh = last_snapshot;
+    double last_change = last_snapshot;
+    int current_fps = ACTIVE_FPS;
+
+    // Cached layers: header, one panel per graph and the correlation overlay. The frame
+    // itself only blits them; they are re-rendered when the data or the view changes.
+    const char *titles[SENSOR_CHANNEL_COUNT] = { "Temperature (°C)", "Humidity (%)", "Illuminance (lux)" };
+    const char *spectrum_titles[SENSOR_CHANNEL_COUNT] = { "Temperature spectrum", "Humidity spectrum", "Illuminance spectrum" };
+    const Color colors[SENSOR_CHANNEL_COUNT] = { RED, BLUE, DARKGREEN };
+    float min_vals[SENSOR_CHANNEL_COUNT] = { 0 }, max_vals[SENSOR_CHANNEL_COUNT] = { 0 };
+    CachedPanel header, overlay;
+    CachedPanel graphs[SENSOR_CHANNEL_COUNT];
+    
+    panel_init(&header, (Rectangle){ 0, 0, WINDOW_WIDTH, GRAPH_TOP_MARGIN - TITLE_OFFSET });
+    panel_init(&overlay, (Rectangle){ WINDOW_WIDTH - 430, GRAPH_TOP_MARGIN + 110, 400, 220 });
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        float graph_y = GRAPH_TOP_MARGIN + i * (GRAPH_HEIGHT + GRAPH_MARGIN);
+        panel_init(&graphs[i], (Rectangle){ 0, graph_y - TITLE_OFFSET, WINDOW_WIDTH, GRAPH_HEIGHT });
+    }
+    unsigned int rendered_version = data_version - 1;
+
     // Main game loop
     while (!WindowShouldClose()) {
-        // Update data
-        load_sensor_data();
+        // F toggles the spectrum view, UP/DOWN change the spectrum window size
+        int view_changed = 0;
+        if (IsKeyPressed(KEY_F)) {
+            show_spectrum = !show_spectrum;
+            view_changed = 1;
+        }
+        if (IsKeyPressed(KEY_C)) {
+            show_correlation = !show_correlation;
+            last_change = GetTime();
+        }
+        if (IsKeyPressed(KEY_A)) {
+            plot_config.aggregate = (plot_config.aggregate + 1) % RESAMPLE_AGGREGATE_COUNT;
+            view_changed = 1;
+        }
+        if (IsKeyPressed(KEY_I)) {
+            plot_config.interpolation = (plot_config.interpolation + 1) % RESAMPLE_INTERP_COUNT;
+            view_changed = 1;
+        }
+        if (IsKeyPressed(KEY_UP) && spectrum_window < SDFT_MAX_WINDOW) {
+            spectrum_window *= 2;
+            seed_spectra();
+            view_changed = 1;
+        }
+        if (IsKeyPressed(KEY_DOWN) && spectrum_window > SPECTRUM_MIN_WINDOW) {
+            spectrum_window /= 2;
+            seed_spectra();
+            view_changed = 1;
+        }
+        
+        // New rollups only change the statistics boxes
+        if (rollups_dirty) {
+            refresh_long_window_sketches();
+            for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+                graphs[i].layer_dirty = 1;
+            }
+        }
+        
+        // Mark layers dirty; the chrome only when the axis range or the view changed
+        if (data_version != rendered_version || view_changed) {
+            resample_readings(readings, reading_count, &plot_config, &plot_grid);
+            prepare_spectra();
+            
+            float new_min[SENSOR_CHANNEL_COUNT], new_max[SENSOR_CHANNEL_COUNT];
+            compute_ranges(new_min, new_max);
+            for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+                if (view_changed || new_min[i] != min_vals[i] || new_max[i] != max_vals[i]) {
+                    graphs[i].chrome_dirty = 1;
+                    min_vals[i] = new_min[i];
+                    max_vals[i] = new_max[i];
+                }
+                graphs[i].layer_dirty = 1;
+            }
+            overlay.layer_dirty = 1;
+            header.layer_dirty = 1;
+            rendered_version = data_version;
+        }
+        
+        // Re-render dirty layers
+        int redrawn = 0;
+        if (header.chrome_dirty) {
+            panel_begin_chrome(&header, RAYWHITE);
+            DrawText("SENSOR DATA VISUALIZATION WITH GSL ANALYSIS", 
+                    WINDOW_WIDTH/2 - MeasureText("SENSOR DATA VISUALIZATION WITH GSL ANALYSIS", 24)/2, 
+                    20, 24, DARKGRAY);
+            DrawText(HELP_TEXT, WINDOW_WIDTH - MeasureText(HELP_TEXT, 14) - 10, 10, 14, GRAY);
+            panel_end_chrome(&header);
+        }
+        if (header.layer_dirty) {
+            panel_begin_layer(&header);
+            draw_latency(WINDOW_WIDTH - 10, 30);
+            panel_end_layer(&header);
+            redrawn = 1;
+        }
+        
+        if (reading_count > 1) {
+            for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+                if (graphs[i].chrome_dirty) {
+                    panel_begin_chrome(&graphs[i], RAYWHITE);
+                    if (show_spectrum) {
+                        draw_spectrum_chrome(spectrum_titles[i], i, colors[i]);
+                    } else {
+                        draw_graph_chrome(titles[i], i, min_vals[i], max_vals[i], colors[i]);
+                    }
+                    panel_end_chrome(&graphs[i]);
+                }
+                if (graphs[i].layer_dirty) {
+                    panel_begin_layer(&graphs[i]);
+                    if (show_spectrum) {
+                        draw_spectrum(i, colors[i]);
+                    } else {
+                        float values[MAX_READINGS];
+                        for (int j = 0; j < reading_count; j++) {
+                            values[j] = sensor_channel_value(&readings[j], i);
+                        }
+                        draw_graph(values, reading_count, &plot_grid, i, min_vals[i], max_vals[i], colors[i]);
+                    }
+                    panel_end_layer(&graphs[i]);
+                    redrawn = 1;
+                }
+            }
+            
+            if (show_correlation && overlay.layer_dirty) {
+                if (overlay.chrome_dirty) {
+                    panel_begin_chrome(&overlay, RAYWHITE);
+                    panel_end_chrome(&overlay);
+                }
+                panel_begin_layer(&overlay);
+                draw_correlation(overlay.bounds.x, overlay.bounds.y);
+                panel_end_layer(&overlay);
+                redrawn = 1;
+            }
+        }
         
         // Begin drawing
         BeginDrawing();
         ClearBackground(RAYWHITE);
         
-        // Draw title
-        DrawText("SENSOR DATA VISUALIZATION WITH GSL ANALYSIS", 
-                WINDOW_WIDTH/2 - MeasureText("SENSOR DATA VISUALIZATION WITH GSL ANALYSIS", 24)/2, 
-                20, 24, DARKGRAY);
+        panel_draw(&header);
         
         // Draw graphs if we have data
         if (reading_count > 1) {
-            // Prepare data arrays
-            float temps[MAX_READINGS], hums[MAX_READINGS], lums[MAX_READINGS];
-            float min_temp = 1000, max_temp = -1000;
-            float min_hum = 1000, max_hum = -1000;
-            float min_lum = 1000000, max_lum = -1;
-            
-            for (int i = 0; i < reading_count; i++) {
-                temps[i] = readings[i].temperature;
-                hums[i] = readings[i].humidity;
-                lums[i] = readings[i].illuminance;
-                
-                if (temps[i] < min_temp) min_temp = temps[i];
-                if (temps[i] > max_temp) max_temp = temps[i];
-                if (hums[i] < min_hum) min_hum = hums[i];
-                if (hums[i] > max_hum) max_hum = hums[i];
-                if (lums[i] < min_lum) min_lum = lums[i];
-                if (lums[i] > max_lum) max_lum = lums[i];
+            for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+                panel_draw(&graphs[i]);
+            }
+            if (show_correlation) {
+                panel_draw(&overlay);
             }
-            
-            // Add some padding to the Y-axis
-            float y_padding = (max_temp - min_temp) * 0.1;
-            min_temp -= y_padding;
-            max_temp += y_padding;
-            
-            y_padding = (max_hum - min_hum) * 0.1;
-            min_hum = fmax(0, min_hum - y_padding);
-            max_hum = fmin(100, max_hum + y_padding);
-            
-            y_padding = (max_lum - min_lum) * 0.1;
-            min_lum = fmax(0, min_lum - y_padding);
-            max_lum *= 1.1;
-            
-            // Draw graphs
-            draw_graph("Temperature (°C)", temps, reading_count, 0, min_temp, max_temp, RED);
-            draw_graph("Humidity (%)", hums, reading_count, 1, min_hum, max_hum, BLUE);
-            draw_graph("Illuminance (lux)", lums, reading_count, 2, min_lum, max_lum, DARKGREEN);
         } else {
             DrawText("Waiting for sensor data...", WINDOW_WIDTH/2 - 100, WINDOW_HEIGHT/2, 20, GRAY);
         }
@@ -114,110 +299,335 @@ int main() {
         DrawFPS(10, 10);
         
         EndDrawing();
+        trace_presented(&latency);
+        
+        // Stay at full rate for a moment after a change, otherwise idle at a low rate
+        if (redrawn) last_change = GetTime();
+        int target_fps = GetTime() - last_change < ACTIVE_PERIOD ? ACTIVE_FPS : IDLE_FPS;
+        if (target_fps != current_fps) {
+            SetTargetFPS(target_fps);
+            current_fps = target_fps;
+        }
+        
+        // Update data after presenting the frame, so a warm start shows the snapshot first
+        // and then catches up with the delta since its cursor
+        load_sensor_data();
+        
+        if (GetTime() - last_rollup_refresh >= ROLLUP_REFRESH_INTERVAL) {
+            load_rollups();
+            last_rollup_refresh = GetTime();
+        }
+        
+        if (GetTime() - last_snapshot >= SNAPSHOT_INTERVAL) {
+            save_snapshot();
+            last_snapshot = GetTime();
+        }
+        
+        if (GetTime() - last_trace_report >= TRACE_REPORT_INTERVAL) {
+            trace_report(&latency, stdout);
+            last_trace_report = GetTime();
+        }
     }
     
     // Cleanup
+    save_snapshot();
+    trace_report(&latency, stdout);
+    panel_unload(&header);
+    panel_unload(&overlay);
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        panel_unload(&graphs[i]);
+    }
     sqlite3_close(db);
     CloseWindow();
     return 0;
 }
 
-void load_sensor_data() {
+// Total readings in the ring, to tell whether a load changed anything
+static long long rollup_total() {
+    long long total = 0;
+    for (int i = 0; i < ROLLUP_BUCKETS; i++) {
+        total += rollups[i].count;
+    }
+    return total;
+}
+
+// Read buckets the writer stored or updated since the last load. The newest bucket is
+// re-read every time, since the writer keeps adding to it. Returns the rows loaded.
+int load_rollups() {
+    long long before = rollup_total(), newest_before = rollup_newest_start;
+    int rows = rollup_load_ring(db, rollup_newest_start, rollups, ROLLUP_BUCKETS, &rollup_newest_start);
+    if (rollup_total() != before || rollup_newest_start != newest_before) rollups_dirty = 1;
+    return rows;
+}
+
+// Merge the rollups within the ring's horizon into the long-window sketches
+void refresh_long_window_sketches() {
+    if (!rollups_dirty) return;
+    
+    long long horizon = rollup_newest_start - (long long)ROLLUP_SECONDS * (ROLLUP_BUCKETS - 1);
+    long long oldest = rollup_newest_start;
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        sketch_init(&long_window_sketches[c]);
+    }
+    for (int i = 0; i < ROLLUP_BUCKETS; i++) {
+        if (rollups[i].count == 0 || rollups[i].start < horizon) continue;
+        if (rollups[i].start < oldest) oldest = rollups[i].start;
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            sketch_merge(&long_window_sketches[c], &rollups[i].sketches[c]);
+        }
+    }
+    long_window_hours = long_window_sketches[0].count > 0
+                      ? (rollup_newest_start + ROLLUP_SECONDS - oldest) / 3600.0 : 0;
+    rollups_dirty = 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Count the interval ending at readings[i] into (sign 1) or out of (sign -1) the spectrum
+// window's uneven and gap tallies, measured against spectrum_nominal
+static void count_spectrum_interval(int i, int sign) {
+    double dt = sensor_reading_time(&readings[i]) - sensor_reading_time(&readings[i - 1]);
+    if (fabs(dt - spectrum_nominal) <= SPECTRUM_MAX_JITTER * spectrum_nominal) return;
+    spectrum_uneven += sign;
+    if (dt > RESAMPLE_GAP_FACTOR * spectrum_nominal) spectrum_gaps += sign;
+}
+
+// Seed the sliding DFTs with a full FFT over the newest spectrum_window readings, and take
+// the median interval as the nominal one the window's spacing is checked against. Only
+// needed when the window size or the reading rate changes or the buffer is replaced;
+// appends slide the DFTs and the tallies.
+void seed_spectra() {
+    float samples[SDFT_MAX_WINDOW];
+    double intervals[SDFT_MAX_WINDOW];
+    
+    spectra_seeded = reading_count >= spectrum_window;
+    if (!spectra_seeded) return;
+    
+    int first = reading_count - spectrum_window;
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        for (int i = 0; i < spectrum_window; i++) {
+            samples[i] = sensor_channel_value(&readings[first + i], c);
+        }
+        sdft_seed(&spectra[c], samples, spectrum_window);
+    }
+    
+    for (int i = 1; i < spectrum_window; i++) {
+        intervals[i - 1] = sensor_reading_time(&readings[first + i]) - sensor_reading_time(&readings[first + i - 1]);
+    }
+    qsort(intervals, spectrum_window - 1, sizeof(double), compare_doubles);
+    spectrum_nominal = intervals[(spectrum_window - 1) / 2];
+    spectrum_uneven = spectrum_gaps = 0;
+    for (int i = first + 1; i < reading_count; i++) {
+        count_spectrum_interval(i, 1);
+    }
+}
+
+// Decide what the spectrum view can show for the newest spectrum_window readings. While
+// nearly all intervals are even and none is a gap, the sliding DFTs are used at the mean
+// interval. Otherwise, only while the view is shown, the readings are resampled onto a
+// uniform grid of the same length and transformed, unless they contain a gap, in which
+// case no spectrum is shown.
+void prepare_spectra() {
+    spectrum_interval = 0;
+    spectrum_from_grid = 0;
+    if (!spectra_seeded) return;
+    
+    int n = spectrum_window;
+    int first = reading_count - n;
+    double span = sensor_reading_time(&readings[reading_count - 1]) - sensor_reading_time(&readings[first]);
+    double mean = span / (n - 1);
+    
+    // Re-take the nominal interval when the reading rate has changed
+    if (fabs(mean - spectrum_nominal) > SPECTRUM_MAX_JITTER * spectrum_nominal) seed_spectra();
+    
+    if (spectrum_nominal > 0 && spectrum_gaps == 0 && spectrum_uneven <= SPECTRUM_MAX_UNEVEN * (n - 1)) {
+        spectrum_interval = mean;
+        return;
+    }
+    if (!show_spectrum) return;
+    
+    // Uneven spacing: put the same readings on an n-point grid spanning them
+    if (span <= 0) {
+        snprintf(spectrum_status, sizeof(spectrum_status), "Readings share one timestamp, no spectrum");
+        return;
+    }
+    ResampleConfig config;
+    resample_default_config(&config);
+    config.step = mean;
+    config.max_bins = n;
+    resample_readings(&readings[first], n, &config, &spectrum_grid);
+    if (spectrum_grid.bins != n || spectrum_grid.gap_count > 0) {
+        snprintf(spectrum_status, sizeof(spectrum_status), "Gap in the last %.0f s, no spectrum", span);
+        return;
+    }
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        sdft_seed(&grid_spectra[c], spectrum_grid.values[c], n);
+    }
+    spectrum_interval = spectrum_grid.step;
+    spectrum_from_grid = 1;
+}
+
+// Rebuild the window sketches, spectra and correlation sums after the whole buffer was replaced
+void rebuild_window_analysis() {
+    correlation_reset(&correlation);
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        sketch_init(&window_sketches[c]);
+    }
+    for (int i = 0; i < reading_count; i++) {
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            sketch_add(&window_sketches[c], sensor_channel_value(&readings[i], c));
+        }
+        float sample[SENSOR_CHANNEL_COUNT];
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            sample[c] = sensor_channel_value(&readings[i], c);
+        }
+        correlation_append(&correlation, sample);
+    }
+    seed_spectra();
+}
+
+// Append a reading, dropping the oldest one when the buffer is full
+static void append_reading(const SensorReading *reading) {
+    if (reading_count >= MAX_READINGS) {
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            sketch_remove(&window_sketches[c], sensor_channel_value(&readings[0], c));
+        }
+        for (int i = 1; i < reading_count; i++) {
+            readings[i-1] = readings[i];
+        }
+        reading_count--;
+    }
+    readings[reading_count++] = *reading;
+    
+    float sample[SENSOR_CHANNEL_COUNT];
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        sample[c] = sensor_channel_value(reading, c);
+        sketch_add(&window_sketches[c], sample[c]);
+    }
+    correlation_append(&correlation, sample);
+    
+    // Slide the spectra: the reading spectrum_window positions back leaves the window,
+    // taking the interval after it along; the new reading brings one in
+    if (spectra_seeded) {
+        const SensorReading *leaving = &readings[reading_count - 1 - spectrum_window];
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            sdft_update(&spectra[c], sensor_channel_value(reading, c), sensor_channel_value(leaving, c));
+        }
+        count_spectrum_interval(reading_count - spectrum_window, -1);
+        count_spectrum_interval(reading_count - 1, 1);
+    } else if (reading_count >= spectrum_window) {
+        seed_spectra();
+    }
+}
+
+// Fetch readings newer than the cursor. Rows are addressed by the INTEGER PRIMARY KEY so
+// neither the MAX lookup nor the range scan touches the unindexed timestamp column.
+// Returns 1 if more rows are pending after this batch.
+int load_sensor_data() {
     sqlite3_stmt *stmt;
-    const char *sql;
+    char sql[512];
     int rc;
     
-    // Get the latest timestamp from the database
-    double latest_db_timestamp = 0;
-    const char *latest_ts_sql = "SELECT strftime('%s', MAX(timestamp)) FROM sensor_readings;";
+    // Get the latest row id from the database
+    long long latest_db_id = 0;
+    const char *latest_id_sql = "SELECT MAX(id) FROM sensor_readings;";
     
-    rc = sqlite3_prepare_v2(db, latest_ts_sql, -1, &stmt, 0);
+    rc = sqlite3_prepare_v2(db, latest_id_sql, -1, &stmt, 0);
     if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
-        latest_db_timestamp = sqlite3_column_double(stmt, 0);
+        latest_db_id = sqlite3_column_int64(stmt, 0);
     }
     sqlite3_finalize(stmt);
     
     // If no new data, return early
-    if (latest_db_timestamp <= last_reading_timestamp) {
-        return;
+    if (latest_db_id == last_reading_id) {
+        return 0;
     }
     
+    // Reload the whole window on first start, if the database was recreated, or if the
+    // delta since the cursor is larger than the window anyway
+    int initial_load = reading_count == 0 || latest_db_id < last_reading_id ||
+                       latest_db_id - last_reading_id > MAX_READINGS;
+    
     // Prepare SQL query
-    if (reading_count > 0) {
-        sql = "SELECT strftime('%s', timestamp) as ts, temperature, humidity, illuminance "
-              "FROM sensor_readings WHERE timestamp > datetime(?, 'unixepoch') "
-              "ORDER BY timestamp ASC";
+    // Trace columns are selected as NULL on databases written by an older simulator
+    const char *trace_columns = trace_enabled ? "seq, gen_time_us, insert_time_us" : "NULL, NULL, NULL";
+    if (initial_load) {
+        snprintf(sql, sizeof(sql),
+                 "SELECT id, strftime('%%s', timestamp) as ts, temperature, humidity, illuminance, %s "
+                 "FROM (SELECT * FROM sensor_readings ORDER BY id DESC LIMIT ?) ORDER BY id ASC", trace_columns);
     } else {
-        sql = "SELECT strftime('%s', timestamp) as ts, temperature, humidity, illuminance "
-              "FROM sensor_readings ORDER BY timestamp DESC LIMIT ?";
+        snprintf(sql, sizeof(sql),
+                 "SELECT id, strftime('%%s', timestamp) as ts, temperature, humidity, illuminance, %s "
+                 "FROM sensor_readings WHERE id > ? ORDER BY id ASC LIMIT ?", trace_columns);
     }
     
     rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        return;
+        return 0;
     }
     
-    if (reading_count > 0) {
-        sqlite3_bind_double(stmt, 1, last_reading_timestamp);
-    } else {
+    if (initial_load) {
         sqlite3_bind_int(stmt, 1, MAX_READINGS);
+    } else {
+        sqlite3_bind_int64(stmt, 1, last_reading_id);
+        sqlite3_bind_int(stmt, 2, LOAD_BATCH_SIZE);
     }
     
     // Process results
     int new_readings = 0;
-    if (reading_count > 0) {
+    if (!initial_load) {
         // Append new readings
-        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && reading_count < MAX_READINGS) {
-            double ts = sqlite3_column_double(stmt, 0);
-            if (ts <= last_reading_timestamp) continue;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            SensorReading reading;
+            last_reading_id = sqlite3_column_int64(stmt, 0);
+            reading.timestamp = sqlite3_column_double(stmt, 1);
+            reading.gen_time = sqlite3_column_type(stmt, 6) != SQLITE_NULL
+                             ? sqlite3_column_int64(stmt, 6) / 1e6 : 0;
+            reading.temperature = sqlite3_column_double(stmt, 2);
+            reading.humidity = sqlite3_column_double(stmt, 3);
+            reading.illuminance = sqlite3_column_double(stmt, 4);
+            append_reading(&reading);
             
-            // If buffer is full, remove oldest reading
-            if (reading_count >= MAX_READINGS) {
-                for (int i = 1; i < reading_count; i++) {
-                    readings[i-1] = readings[i];
-                }
-                reading_count--;
+            if (sqlite3_column_type(stmt, 6) != SQLITE_NULL) {
+                trace_loaded(&latency, sqlite3_column_int64(stmt, 5),
+                             sqlite3_column_int64(stmt, 6), sqlite3_column_int64(stmt, 7));
             }
-            
-            // Add new reading at the end
-            readings[reading_count].timestamp = ts;
-            readings[reading_count].temperature = sqlite3_column_double(stmt, 1);
-            readings[reading_count].humidity = sqlite3_column_double(stmt, 2);
-            readings[reading_count].illuminance = sqlite3_column_double(stmt, 3);
-            
-            reading_count++;
             new_readings++;
-            last_reading_timestamp = ts;
         }
     } else {
-        // Initial load
+        // Full reload, oldest first. Rows past the previous cursor are new since the last
+        // poll, so they are traced like appended ones; readings skipped over count as gaps.
+        long long previous_id = latest_db_id > last_reading_id ? last_reading_id : 0;
         reading_count = 0;
+        last_reading_id = 0;
         while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && reading_count < MAX_READINGS) {
-            readings[reading_count].timestamp = sqlite3_column_double(stmt, 0);
-            readings[reading_count].temperature = sqlite3_column_double(stmt, 1);
-            readings[reading_count].humidity = sqlite3_column_double(stmt, 2);
-            readings[reading_count].illuminance = sqlite3_column_double(stmt, 3);
-            
-            if (readings[reading_count].timestamp > last_reading_timestamp) {
-                last_reading_timestamp = readings[reading_count].timestamp;
+            last_reading_id = sqlite3_column_int64(stmt, 0);
+            if (previous_id > 0 && last_reading_id > previous_id &&
+                sqlite3_column_type(stmt, 6) != SQLITE_NULL) {
+                trace_loaded(&latency, sqlite3_column_int64(stmt, 5),
+                             sqlite3_column_int64(stmt, 6), sqlite3_column_int64(stmt, 7));
             }
-            
+            readings[reading_count].timestamp = sqlite3_column_double(stmt, 1);
+            readings[reading_count].gen_time = sqlite3_column_type(stmt, 6) != SQLITE_NULL
+                                             ? sqlite3_column_int64(stmt, 6) / 1e6 : 0;
+            readings[reading_count].temperature = sqlite3_column_double(stmt, 2);
+            readings[reading_count].humidity = sqlite3_column_double(stmt, 3);
+            readings[reading_count].illuminance = sqlite3_column_double(stmt, 4);
             reading_count++;
         }
         
-        // If we loaded data in reverse order (DESC), reverse the array
-        if (reading_count > 0) {
-            for (int i = 0; i < reading_count / 2; i++) {
-                SensorReading temp = readings[i];
-                readings[i] = readings[reading_count - 1 - i];
-                readings[reading_count - 1 - i] = temp;
-            }
-        }
-        
+        rebuild_window_analysis();
         printf("Initial load: %d readings.\n", reading_count);
     }
     
+    if (initial_load || new_readings > 0) {
+        data_version++;
+    }
+    
     if (rc != SQLITE_DONE) {
         fprintf(stderr, "Error during query execution: %s\n", sqlite3_errmsg(db));
     } else if (new_readings > 0) {
@@ -225,33 +635,80 @@ void load_sensor_data() {
     }
     
     sqlite3_finalize(stmt);
+    
+    return !initial_load && new_readings == LOAD_BATCH_SIZE;
+}
+
+// Persist the window so the next start can render without waiting for the database
+void save_snapshot() {
+    if (last_reading_id == saved_reading_id) return;
+    if (snapshot_save(SNAPSHOT_PATH, readings, reading_count, last_reading_id) == 0) {
+        saved_reading_id = last_reading_id;
+    }
 }
 
-void draw_statistics(float x, float y, float mean, float median, float sd, float min, float max, Color color) {
+void draw_statistics(float x, float y, float mean, float sd, float min, float max,
+                     const float *window_q, const float *long_q, Color color) {
     char text[128];
     
     // Draw statistics box
-    DrawRectangle(x, y, 200, 80, Fade(LIGHTGRAY, 0.7f));
-    DrawRectangleLines(x, y, 200, 80, Fade(color, 0.5f));
+    DrawRectangle(x, y, 240, 85, Fade(LIGHTGRAY, 0.7f));
+    DrawRectangleLines(x, y, 240, 85, Fade(color, 0.5f));
     
     // Draw statistics text
     snprintf(text, sizeof(text), "Mean: %.2f", mean);
     DrawText(text, x + 5, y + 5, 14, color);
     
-    snprintf(text, sizeof(text), "Median: %.2f", median);
+    snprintf(text, sizeof(text), "Median: %.2f", window_q[0]);
     DrawText(text, x + 5, y + 25, 14, color);
     
     snprintf(text, sizeof(text), "SD: %.2f", sd);
     DrawText(text, x + 5, y + 45, 14, color);
     
     snprintf(text, sizeof(text), "Min/Max: %.1f/%.1f", min, max);
-    DrawText(text, x + 100, y + 5, 14, color);
+    DrawText(text, x + 120, y + 5, 14, color);
+    
+    snprintf(text, sizeof(text), "P95/P99: %.1f/%.1f", window_q[1], window_q[2]);
+    DrawText(text, x + 120, y + 25, 14, color);
+    
+    // Percentiles over the rollups, labelled with the span they actually cover
+    if (long_window_hours > 0) {
+        snprintf(text, sizeof(text), "%.*fh P50/P95/P99: %.1f/%.1f/%.1f", long_window_hours < 10 ? 1 : 0,
+                 long_window_hours, long_q[0], long_q[1], long_q[2]);
+    } else {
+        snprintf(text, sizeof(text), "Long window: no rollups yet");
+    }
+    DrawText(text, x + 5, y + 65, 14, color);
 }
 
-void draw_graph(const char* title, float *values, int count, int graph_index, 
-                float min_val, float max_val, Color color) {
-    if (count < 2) return;
+// Y-axis range per channel over the window, padded by 10%
+void compute_ranges(float *min_vals, float *max_vals) {
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        min_vals[c] = 0;
+        max_vals[c] = 0;
+        for (int i = 0; i < reading_count; i++) {
+            float v = sensor_channel_value(&readings[i], c);
+            if (i == 0 || v < min_vals[c]) min_vals[c] = v;
+            if (i == 0 || v > max_vals[c]) max_vals[c] = v;
+        }
+    }
+    
+    // Add some padding to the Y-axis
+    float y_padding = (max_vals[0] - min_vals[0]) * 0.1;
+    min_vals[0] -= y_padding;
+    max_vals[0] += y_padding;
     
+    y_padding = (max_vals[1] - min_vals[1]) * 0.1;
+    min_vals[1] = fmax(0, min_vals[1] - y_padding);
+    max_vals[1] = fmin(100, max_vals[1] + y_padding);
+    
+    y_padding = (max_vals[2] - min_vals[2]) * 0.1;
+    min_vals[2] = fmax(0, min_vals[2] - y_padding);
+    max_vals[2] *= 1.1;
+}
+
+// Parts of a graph that only change with its range: title, background, grid, Y labels
+void draw_graph_chrome(const char* title, int graph_index, float min_val, float max_val, Color color) {
     // Calculate graph position and dimensions
     float graph_x = GRAPH_LEFT_MARGIN + Y_LABEL_WIDTH;
     float graph_y = GRAPH_TOP_MARGIN + graph_index * (GRAPH_HEIGHT + GRAPH_MARGIN);
@@ -265,10 +722,6 @@ void draw_graph(const char* title, float *values, int count, int graph_index,
     DrawRectangle(graph_x, graph_y, graph_width, graph_height, Fade(RAYWHITE, 0.8f));
     DrawRectangleLines(graph_x, graph_y, graph_width, graph_height, Fade(color, 0.3f));
     
-    // Calculate scales
-    float x_scale = (graph_width - 20) / (count - 1);
-    float y_scale = (graph_height - 20) / (max_val - min_val);
-    
     // Draw grid lines and Y-axis labels
     for (int i = 0; i <= 5; i++) {
         float value = min_val + (max_val - min_val) * (1.0f - (float)i / 5);
@@ -283,17 +736,41 @@ void draw_graph(const char* title, float *values, int count, int graph_index,
         int text_width = MeasureText(value_text, 12);
         DrawText(value_text, graph_x - text_width - 5, y - 6, 12, DARKGRAY);
     }
+}
+
+// Data-dependent parts of a graph: statistics, points, moving average, mean, time labels.
+// Statistics use the raw readings; the plot is placed by time on the resampled grid and
+// breaks across gaps in the data.
+void draw_graph(float *values, int count, const ResampledGrid *grid, int graph_index,
+                float min_val, float max_val, Color color) {
+    int bins = grid->bins;
+    if (count < 2 || bins < 2) return;
     
-    // Calculate moving average
-    float moving_avg[MAX_READINGS] = {0};
-    if (count >= MOVING_AVG_WINDOW) {
-        for (int i = MOVING_AVG_WINDOW/2; i < count - MOVING_AVG_WINDOW/2; i++) {
-            float sum = 0;
-            for (int j = -MOVING_AVG_WINDOW/2; j <= MOVING_AVG_WINDOW/2; j++) {
-                sum += values[i + j];
-            }
-            moving_avg[i] = sum / MOVING_AVG_WINDOW;
+    // Calculate graph position and dimensions
+    float graph_x = GRAPH_LEFT_MARGIN + Y_LABEL_WIDTH;
+    float graph_y = GRAPH_TOP_MARGIN + graph_index * (GRAPH_HEIGHT + GRAPH_MARGIN);
+    float graph_width = WINDOW_WIDTH - GRAPH_LEFT_MARGIN - GRAPH_MARGIN - Y_LABEL_WIDTH;
+    float graph_height = GRAPH_HEIGHT - GRAPH_BOTTOM_MARGIN;
+    const float *grid_values = grid->values[graph_index];
+    
+    // Calculate scales
+    float x_scale = (graph_width - 20) / (bins - 1);
+    float y_scale = (graph_height - 20) / (max_val - min_val);
+    
+    // Moving average over MOVING_AVG_WINDOW bins of time. Bins without a value are zero,
+    // so the window sums need no branches; an average needs most of its window present.
+    float moving_avg[RESAMPLE_MAX_BINS] = {0};
+    int half = MOVING_AVG_WINDOW / 2;
+    for (int i = 0; i < bins; i++) {
+        int lo = i - half < 0 ? 0 : i - half;
+        int hi = i + half >= bins ? bins - 1 : i + half;
+        float sum = 0;
+        int present = 0;
+        for (int j = lo; j <= hi; j++) {
+            sum += grid_values[j];
+            present += resample_has_value(grid, j);
         }
+        moving_avg[i] = present > half ? sum / present : NAN;
     }
     
     // Calculate statistics using GSL
@@ -302,44 +779,53 @@ void draw_graph(const char* title, float *values, int count, int graph_index,
     float min = gsl_stats_float_min(values, 1, count);
     float max = gsl_stats_float_max(values, 1, count);
     
-    // Sort for median calculation
-    float *sorted_values = (float *)malloc(count * sizeof(float));
-    for (int i = 0; i < count; i++) sorted_values[i] = values[i];
-    gsl_sort_float(sorted_values, 1, count);
-    float median = gsl_stats_float_median_from_sorted_data(sorted_values, 1, count);
-    free(sorted_values);
+    // Percentiles from the sketches instead of sorting the window every frame
+    const float quantiles[3] = {0.50f, 0.95f, 0.99f};
+    float window_q[3], long_q[3];
+    for (int i = 0; i < 3; i++) {
+        window_q[i] = sketch_quantile(&window_sketches[graph_index], quantiles[i]);
+        long_q[i] = sketch_quantile(&long_window_sketches[graph_index], quantiles[i]);
+    }
     
     // Draw statistics
-    draw_statistics(graph_x + graph_width - 210, graph_y + 10, mean, median, sd, min, max, color);
+    draw_statistics(graph_x + graph_width - 250, graph_y + 10, mean, sd, min, max, window_q, long_q, color);
     
-    // Draw data points and lines
+    // Draw data points and lines; a gap ends both the data line and the moving average
     Vector2 prev_point = {0};
     Vector2 prev_avg_point = {0};
+    int has_prev = 0, has_prev_avg = 0;
     
-    for (int i = 0; i < count; i++) {
+    for (int i = 0; i < bins; i++) {
+        if (!resample_has_value(grid, i)) {
+            if (grid->mask[i] == RESAMPLE_GAP) has_prev = has_prev_avg = 0;
+            continue;
+        }
         float x = graph_x + 10 + i * x_scale;
-        float y = graph_y + 10 + (max_val - values[i]) * y_scale;
+        float y = graph_y + 10 + (max_val - grid_values[i]) * y_scale;
         
-        // Draw data point
-        DrawCircle(x, y, 2, Fade(color, 0.7f));
+        // Draw data point where there was a reading
+        if (grid->mask[i] == RESAMPLE_OBSERVED) {
+            DrawCircle(x, y, 2, Fade(color, 0.7f));
+        }
         
         // Draw line to previous point
-        if (i > 0) {
+        if (has_prev) {
             DrawLine(prev_point.x, prev_point.y, x, y, Fade(color, 0.3f));
         }
+        prev_point = (Vector2){x, y};
+        has_prev = 1;
         
         // Draw moving average line
-        if (i >= MOVING_AVG_WINDOW/2 && i < count - MOVING_AVG_WINDOW/2) {
-            float avg_y = graph_y + 10 + (max_val - moving_avg[i]) * y_scale;
-            
-            if (i > MOVING_AVG_WINDOW/2) {
-                DrawLine(prev_avg_point.x, prev_avg_point.y, x, avg_y, Fade(MAROON, 0.8f));
-            }
-            
-            prev_avg_point = (Vector2){x, avg_y};
+        if (isnan(moving_avg[i])) {
+            has_prev_avg = 0;
+            continue;
         }
-        
-        prev_point = (Vector2){x, y};
+        float avg_y = graph_y + 10 + (max_val - moving_avg[i]) * y_scale;
+        if (has_prev_avg) {
+            DrawLine(prev_avg_point.x, prev_avg_point.y, x, avg_y, Fade(MAROON, 0.8f));
+        }
+        prev_avg_point = (Vector2){x, avg_y};
+        has_prev_avg = 1;
     }
     
     // Draw mean line
@@ -347,20 +833,149 @@ void draw_graph(const char* title, float *values, int count, int graph_index,
     DrawLine(graph_x + 10, mean_y, graph_x + graph_width - 10, mean_y, 
              Fade(GOLD, 0.7f));
     
-    // Draw time labels on X-axis
-    if (count > 1) {
-        // First point time (KST = UTC+9)
-        time_t first_time = (time_t)readings[0].timestamp + (9 * 3600);
-        struct tm *tm_info = gmtime(&first_time);
-        char time_buf[20];
-        strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
-        DrawText(time_buf, graph_x + 10, graph_y + graph_height + 5, 12, DARKGRAY);
+    // Draw time labels on X-axis: first and last bin (KST = UTC+9)
+    time_t first_time = (time_t)resample_bin_time(grid, 0) + (9 * 3600);
+    struct tm *tm_info = gmtime(&first_time);
+    char time_buf[20];
+    strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
+    DrawText(time_buf, graph_x + 10, graph_y + graph_height + 5, 12, DARKGRAY);
+    
+    time_t last_time = (time_t)resample_bin_time(grid, bins - 1) + (9 * 3600);
+    tm_info = gmtime(&last_time);
+    strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
+    int text_width = MeasureText(time_buf, 12);
+    DrawText(time_buf, graph_x + graph_width - text_width - 10, graph_y + graph_height + 5, 12, DARKGRAY);
+    
+    // Resampling settings between the time labels
+    char grid_text[96];
+    snprintf(grid_text, sizeof(grid_text), "%.3g s grid, %s, %s interpolation, %d gap%s",
+             grid->step, resample_aggregate_name(plot_config.aggregate),
+             resample_interpolation_name(plot_config.interpolation),
+             grid->gap_count, grid->gap_count == 1 ? "" : "s");
+    text_width = MeasureText(grid_text, 12);
+    DrawText(grid_text, graph_x + (graph_width - text_width) / 2, graph_y + graph_height + 5, 12, GRAY);
+}
+
+void draw_spectrum_chrome(const char* title, int graph_index, Color color) {
+    // Same placement as draw_graph
+    float graph_x = GRAPH_LEFT_MARGIN + Y_LABEL_WIDTH;
+    float graph_y = GRAPH_TOP_MARGIN + graph_index * (GRAPH_HEIGHT + GRAPH_MARGIN);
+    float graph_width = WINDOW_WIDTH - GRAPH_LEFT_MARGIN - GRAPH_MARGIN - Y_LABEL_WIDTH;
+    float graph_height = GRAPH_HEIGHT - GRAPH_BOTTOM_MARGIN;
+    
+    // Draw title (left-aligned)
+    DrawText(title, graph_x + 5, graph_y - TITLE_OFFSET, 20, color);
+    
+    // Draw background and border
+    DrawRectangle(graph_x, graph_y, graph_width, graph_height, Fade(RAYWHITE, 0.8f));
+    DrawRectangleLines(graph_x, graph_y, graph_width, graph_height, Fade(color, 0.3f));
+}
+
+void draw_spectrum(int graph_index, Color color) {
+    // Same placement as draw_graph
+    float graph_x = GRAPH_LEFT_MARGIN + Y_LABEL_WIDTH;
+    float graph_y = GRAPH_TOP_MARGIN + graph_index * (GRAPH_HEIGHT + GRAPH_MARGIN);
+    float graph_width = WINDOW_WIDTH - GRAPH_LEFT_MARGIN - GRAPH_MARGIN - Y_LABEL_WIDTH;
+    float graph_height = GRAPH_HEIGHT - GRAPH_BOTTOM_MARGIN;
+    char text[128];
+    
+    if (!spectra_seeded) {
+        snprintf(text, sizeof(text), "Need %d readings for a %d-point spectrum", spectrum_window, spectrum_window);
+        DrawText(text, graph_x + 20, graph_y + 40, 14, GRAY);
+        return;
+    }
+    
+    if (spectrum_interval <= 0) {
+        DrawText(spectrum_status, graph_x + 20, graph_y + 40, 14, GRAY);
+        return;
+    }
+    
+    const SlidingDft *sdft = spectrum_from_grid ? &grid_spectra[graph_index] : &spectra[graph_index];
+    double sample_interval = spectrum_interval;
+    
+    // Skip the DC bin, scale bars to the strongest remaining bin
+    float max_amp = 0;
+    int peak_bin = 1;
+    for (int k = 1; k < sdft->bins; k++) {
+        float amp = sdft_amplitude(sdft, k);
+        if (amp > max_amp) {
+            max_amp = amp;
+            peak_bin = k;
+        }
+    }
+    if (max_amp <= 0) max_amp = 1;
+    
+    float bar_width = (graph_width - 20) / (sdft->bins - 1);
+    for (int k = 1; k < sdft->bins; k++) {
+        float bar_height = (graph_height - 20) * sdft_amplitude(sdft, k) / max_amp;
+        float x = graph_x + 10 + (k - 1) * bar_width;
+        DrawRectangle(x, graph_y + graph_height - 10 - bar_height, fmax(1, bar_width - 1), bar_height,
+                      Fade(color, k == peak_bin ? 0.9f : 0.5f));
+    }
+    
+    // Frequencies in cycles per hour
+    double bin_hz = 1.0 / (sample_interval * spectrum_window);
+    double peak_cph = peak_bin * bin_hz * 3600.0;
+    snprintf(text, sizeof(text), "Peak: %.2f cycles/h (period %.1f min), amplitude %.2f",
+             peak_cph, 60.0 / peak_cph, sdft_amplitude(sdft, peak_bin));
+    DrawText(text, graph_x + graph_width - MeasureText(text, 14) - 10, graph_y + 10, 14, color);
+    
+    // Frequency axis labels
+    snprintf(text, sizeof(text), "%.2f cycles/h", bin_hz * 3600.0);
+    DrawText(text, graph_x + 10, graph_y + graph_height + 5, 12, DARKGRAY);
+    snprintf(text, sizeof(text), "%.2f cycles/h (N=%d%s)", (sdft->bins - 1) * bin_hz * 3600.0, spectrum_window,
+             spectrum_from_grid ? ", resampled" : "");
+    DrawText(text, graph_x + graph_width - MeasureText(text, 12) - 10, graph_y + graph_height + 5, 12, DARKGRAY);
+}
+
+// Correlation heatmap (red = positive, blue = negative) with the best lag per pair
+void draw_correlation(float x, float y) {
+    const char *labels[SENSOR_CHANNEL_COUNT] = {"Temp", "Hum", "Lux"};
+    const int cell = 50;
+    const int label_width = 45;
+    char text[128];
+    
+    DrawRectangle(x, y, 400, 220, Fade(RAYWHITE, 0.95f));
+    DrawRectangleLines(x, y, 400, 220, GRAY);
+    DrawText("Correlation (window)", x + 10, y + 8, 16, DARKGRAY);
+    
+    float grid_x = x + 10 + label_width;
+    float grid_y = y + 50;
+    for (int a = 0; a < SENSOR_CHANNEL_COUNT; a++) {
+        DrawText(labels[a], grid_x + a * cell + 10, grid_y - 18, 14, DARKGRAY);
+        DrawText(labels[a], x + 10, grid_y + a * cell + 18, 14, DARKGRAY);
         
-        // Last point time
-        time_t last_time = (time_t)readings[count-1].timestamp + (9 * 3600);
-        tm_info = gmtime(&last_time);
-        strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
-        int text_width = MeasureText(time_buf, 12);
-        DrawText(time_buf, graph_x + graph_width - text_width - 10, graph_y + graph_height + 5, 12, DARKGRAY);
+        for (int b = 0; b < SENSOR_CHANNEL_COUNT; b++) {
+            float r = correlation_coefficient(&correlation, a, b);
+            Color shade = r >= 0 ? RED : BLUE;
+            DrawRectangle(grid_x + b * cell, grid_y + a * cell, cell - 2, cell - 2, Fade(shade, fabsf(r)));
+            
+            snprintf(text, sizeof(text), "%.2f", r);
+            DrawText(text, grid_x + b * cell + (cell - MeasureText(text, 14)) / 2, grid_y + a * cell + 18, 14, BLACK);
+        }
     }
+    
+    // Lag is in samples: a positive lag means the second channel leads the first
+    float text_x = grid_x + SENSOR_CHANNEL_COUNT * cell + 15;
+    DrawText("Best lag", text_x, grid_y - 18, 14, DARKGRAY);
+    int line = 0;
+    for (int a = 0; a < SENSOR_CHANNEL_COUNT; a++) {
+        for (int b = a + 1; b < SENSOR_CHANNEL_COUNT; b++) {
+            float r;
+            int lag = correlation_best_lag(&correlation, a, b, &r);
+            snprintf(text, sizeof(text), "%s/%s: %+d (r=%.2f)", labels[a], labels[b], lag, r);
+            DrawText(text, text_x, grid_y + line * 22, 14, DARKGRAY);
+            line++;
+        }
+    }
+}
+
+// Generation-to-screen latency, right-aligned at `right`
+void draw_latency(float right, float y) {
+    if (latency.traced == 0) return;
+    
+    char text[128];
+    snprintf(text, sizeof(text), "Generate->draw latency: p50 %.0f ms, p99 %.0f ms",
+             trace_gen_to_draw_ms(&latency, 0.50f), trace_gen_to_draw_ms(&latency, 0.99f));
+    DrawText(text, right - MeasureText(text, 14), y, 14, GRAY);
 }
@@ -0,0 +1,36 @@
+#ifndef SENSOR_READING_H
+#define SENSOR_READING_H
+
+#include <math.h>
+
+// Number of measured channels per reading (temperature, humidity, illuminance)
+#define SENSOR_CHANNEL_COUNT 3
+
+typedef struct {
+    double timestamp;           // The timestamp column (local time, whole seconds)
+    double gen_time;            // Generation time from gen_time_us (unix seconds); 0 if not recorded
+    float temperature;
+    float humidity;
+    float illuminance;
+} SensorReading;
+
+// Channel accessor so analysis code can loop over channels by index
+static inline float sensor_channel_value(const SensorReading *reading, int channel) {
+    switch (channel) {
+        case 0: return reading->temperature;
+        case 1: return reading->humidity;
+        default: return reading->illuminance;
+    }
+}
+
+// Time to place a reading at on a time axis: the precise generation time where it was
+// recorded, otherwise the timestamp. The timestamp column holds local time, so the generation
+// time is shifted by the UTC offset (a multiple of 15 minutes) to keep one time basis when a
+// window mixes both kinds of rows.
+static inline double sensor_reading_time(const SensorReading *reading) {
+    if (reading->gen_time <= 0) return reading->timestamp;
+    double utc_offset = 900.0 * floor((reading->timestamp - reading->gen_time) / 900.0 + 0.5);
+    return reading->gen_time + utc_offset;
+}
+
+#endif
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include "sensor_rollup.h"
+
+void rollup_init(RollupBucket *bucket, long long start) {
+    bucket->start = start;
+    bucket->count = 0;
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        sketch_init(&bucket->sketches[c]);
+    }
+}
+
+static void rollup_add(RollupBucket *bucket, const float values[SENSOR_CHANNEL_COUNT]) {
+    bucket->count++;
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+        sketch_add(&bucket->sketches[c], values[c]);
+    }
+}
+
+static int table_exists(sqlite3 *db) {
+    sqlite3_stmt *stmt;
+    int exists = 0;
+    const char *sql = "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'sensor_rollups';";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return -1;
+    exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return exists;
+}
+
+// Roll up existing readings, timed by gen_time_us or, for rows from before it was recorded,
+// by their local-time timestamp
+static int backfill(sqlite3 *db) {
+    sqlite3_stmt *stmt;
+    const char *sql =
+        "WITH r AS (SELECT id, temperature, humidity, illuminance, "
+        "COALESCE(gen_time_us / 1000000, CAST(strftime('%s', timestamp, 'utc') AS INTEGER)) AS t "
+        "FROM sensor_readings) "
+        "SELECT t, temperature, humidity, illuminance FROM r "
+        "WHERE t >= (SELECT MAX(t) FROM r) - ? ORDER BY id;";
+
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+    if (rc != SQLITE_OK) return rc;
+    sqlite3_bind_int64(stmt, 1, (long long)ROLLUP_SECONDS * ROLLUP_BUCKETS);
+
+    static RollupBucket current;
+    rollup_init(&current, -1);
+    int rows = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        float values[SENSOR_CHANNEL_COUNT];
+        for (int c = 0; c < SENSOR_CHANNEL_COUNT; c++) {
+            values[c] = (float)sqlite3_column_double(stmt, c + 1);
+        }
+        rc = rollup_accumulate(db, &current, sqlite3_column_int64(stmt, 0), values);
+        if (rc != SQLITE_OK) break;
+        rows++;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE && rc != SQLITE_OK) return rc;
+    if (current.start >= 0 && (rc = rollup_store(db, &current)) != SQLITE_OK) return rc;
+
+    if (rows > 0) printf("Rolled up %d existing readings.\n", rows);
+    return SQLITE_OK;
+}
+
+int rollup_create_table(sqlite3 *db) {
+    const char *create_sql =
+        "CREATE TABLE sensor_rollups ("
+        "bucket_start INTEGER NOT NULL,"
+        "channel INTEGER NOT NULL,"
+        "count INTEGER NOT NULL,"
+        "sketch BLOB NOT NULL,"
+        "PRIMARY KEY (bucket_start, channel));";
+
+    int exists = table_exists(db);
+    if (exists != 0) return exists > 0 ? 0 : -1;
+
+    // Created and backfilled in one transaction, so an interrupted backfill is redone
+    int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", 0, 0, 0);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, create_sql, 0, 0, 0);
+    if (rc == SQLITE_OK) rc = backfill(db);
+    if (rc == SQLITE_OK) rc = sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to create sensor_rollups: %s\n", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", 0, 0, 0);
+        return -1;
+    }
+    return 0;
+}
+
+int rollup_store(sqlite3 *db, const RollupBucket *bucket) {
+    static unsigned char blob[SKETCH_MAX_ENCODED_SIZE];
+    sqlite3_stmt *stmt;
+    const char *sql = "INSERT OR REPLACE INTO sensor_rollups (bucket_start, channel, count, sketch) "
+                      "VALUES (?, ?, ?, ?);";
+
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+    if (rc != SQLITE_OK) return rc;
+
+    for (int c = 0; c < SENSOR_CHANNEL_COUNT && rc == SQLITE_OK; c++) {
+        int size = sketch_encode(&bucket->sketches[c], blob, sizeof(blob));
+        sqlite3_bind_int64(stmt, 1, bucket->start);
+        sqlite3_bind_int(stmt, 2, c);
+        sqlite3_bind_int(stmt, 3, bucket->count);
+        sqlite3_bind_blob(stmt, 4, blob, size, SQLITE_STATIC);
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc == SQLITE_DONE) rc = SQLITE_OK;
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+// Decode one stored row into the matching bucket's sketch; 0 on success, -1 if it's invalid
+static int decode_row(sqlite3_stmt *stmt, RollupBucket *bucket) {
+    int channel = sqlite3_column_int(stmt, 1);
+    if (channel < 0 || channel >= SENSOR_CHANNEL_COUNT) return -1;
+
+    const unsigned char *blob = sqlite3_column_blob(stmt, 3);
+    if (sketch_decode(&bucket->sketches[channel], blob, sqlite3_column_bytes(stmt, 3)) != 0) return -1;
+    bucket->count = sqlite3_column_int(stmt, 2);
+    return 0;
+}
+
+int rollup_fetch(sqlite3 *db, long long start, RollupBucket *bucket) {
+    sqlite3_stmt *stmt;
+    const char *sql = "SELECT bucket_start, channel, count, sketch FROM sensor_rollups "
+                      "WHERE bucket_start = ?;";
+
+    rollup_init(bucket, start);
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
+    if (rc != SQLITE_OK) return rc;
+    sqlite3_bind_int64(stmt, 1, start);
+
+    int invalid = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (decode_row(stmt, bucket) != 0) invalid = 1;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        rollup_init(bucket, start);
+        return rc;
+    }
+
+    // A damaged bucket is rebuilt from the readings that still arrive for it
+    if (invalid) {
+        fprintf(stderr, "Discarding invalid rollup at %lld\n", start);
+        rollup_init(bucket, start);
+    }
+    return SQLITE_OK;
+}
+
+int rollup_accumulate(sqlite3 *db, RollupBucket *current, long long unix_seconds,
+                      const float values[SENSOR_CHANNEL_COUNT]) {
+    long long start = rollup_bucket_start(unix_seconds);
+    if (current->start != start) {
+        int rc = current->start >= 0 ? rollup_store(db, current) : SQLITE_OK;
+        if (rc == SQLITE_OK) rc = rollup_fetch(db, start, current);
+        if (rc != SQLITE_OK) {
+            rollup_init(current, -1);
+            return rc;
+        }
+    }
+    rollup_add(current, values);
+    return SQLITE_OK;
+}
+
+int rollup_load_ring(sqlite3 *db, long long since, RollupBucket *ring, int ring_size, long long *newest) {
+    sqlite3_stmt *stmt;
+    const char *sql = "SELECT bucket_start, channel, count, sketch FROM sensor_rollups "
+                      "WHERE bucket_start >= MAX(?, (SELECT MAX(bucket_start) FROM sensor_rollups) - ?) "
+                      "ORDER BY bucket_start;";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return -1;
+    sqlite3_bind_int64(stmt, 1, since);
+    sqlite3_bind_int64(stmt, 2, (long long)(ring_size - 1) * ROLLUP_SECONDS);
+
+    int rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        long long start = sqlite3_column_int64(stmt, 0);
+        if (start < 0) continue;
+
+        // Recycle a slot that still holds an older bucket
+        RollupBucket *bucket = &ring[(start / ROLLUP_SECONDS) % ring_size];
+        if (bucket->start != start) rollup_init(bucket, start);
+        if (decode_row(stmt, bucket) != 0) continue;
+
+        if (start > *newest) *newest = start;
+        rows++;
+    }
+    sqlite3_finalize(stmt);
+    return rows;
+}
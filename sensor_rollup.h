@@ -0,0 +1,48 @@
+#ifndef SENSOR_ROLLUP_H
+#define SENSOR_ROLLUP_H
+
+#include <sqlite3.h>
+#include "sensor_reading.h"
+#include "quantile_sketch.h"
+
+// Long-window percentiles: as the writer inserts readings it keeps one quantile sketch per
+// channel and ROLLUP_SECONDS bucket in the sensor_rollups table, and the visualizer merges
+// the newest ROLLUP_BUCKETS of them instead of holding a day of readings.
+#define ROLLUP_SECONDS 600          // Width of one rollup bucket
+#define ROLLUP_BUCKETS 144          // Buckets in the long window (24 hours of 10-minute buckets)
+
+typedef struct {
+    long long start;                // Bucket start in unix seconds (generation time); -1 if unused
+    int count;
+    QuantileSketch sketches[SENSOR_CHANNEL_COUNT];
+} RollupBucket;
+
+void rollup_init(RollupBucket *bucket, long long start);
+
+static inline long long rollup_bucket_start(long long unix_seconds) {
+    return unix_seconds - unix_seconds % ROLLUP_SECONDS;
+}
+
+// Create sensor_rollups if it is missing, rolling up the readings already in the database
+// from the last ROLLUP_BUCKETS. Returns 0 on success, -1 on failure.
+int rollup_create_table(sqlite3 *db);
+
+// Write the bucket's sketches, replacing what is stored for it. Returns an SQLite result code.
+int rollup_store(sqlite3 *db, const RollupBucket *bucket);
+
+// Read the bucket starting at `start`; it is left empty if nothing is stored yet.
+// Returns an SQLite result code.
+int rollup_fetch(sqlite3 *db, long long start, RollupBucket *bucket);
+
+// Add a reading taken at `unix_seconds` to `current`, the bucket being built. If the reading
+// belongs to another bucket, the current one is stored and that one fetched first.
+// Returns an SQLite result code.
+int rollup_accumulate(sqlite3 *db, RollupBucket *current, long long unix_seconds,
+                      const float values[SENSOR_CHANNEL_COUNT]);
+
+// Load the stored buckets starting at or after `since` (and at most ROLLUP_BUCKETS before
+// the newest) into `ring`, at slot (start / ROLLUP_SECONDS) % ring_size. *newest is raised to
+// the newest bucket start seen. Returns the number of rows loaded, or -1 if the table can't be read.
+int rollup_load_ring(sqlite3 *db, long long since, RollupBucket *ring, int ring_size, long long *newest);
+
+#endif
@@ -1,9 +1,26 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
-#include <sqlite3.h> 
+#include <string.h>
+#include <sqlite3.h>
 #include <time.h>
-#include <unistd.h>
 #include <math.h>
+#include <signal.h>
+#include "sensor_writer.h"
+#include "latency_trace.h"
+
+#define DEFAULT_RATE 0.1            // Readings per second in normal mode (one every 10 seconds)
+#define SOAK_REPORT_INTERVAL 10     // Seconds between progress lines in soak mode
+#define JOURNAL_PATH "sensor_data.journal"
+#define SHUTDOWN_DRAIN_TIME 5       // Seconds to keep writing the backlog after stopping
+
+static volatile sig_atomic_t stop_requested = 0;
+
+void handle_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
 
 float random_float(float min, float max) {
     return min + ((float)rand() / RAND_MAX) * (max - min);
@@ -15,12 +32,60 @@ void get_current_timestamp(char *timestamp, size_t size) {
     strftime(timestamp, size, "%Y-%m-%d %H:%M:%S", t);
 }
 
-int main() {
+void sleep_until_us(long long deadline) {
+    long long remaining = deadline - trace_now_us();
+    if (remaining <= 0) return;
+    struct timespec ts;
+    ts.tv_sec = remaining / 1000000LL;
+    ts.tv_nsec = (remaining % 1000000LL) * 1000;
+    nanosleep(&ts, NULL);
+}
+
+// Add a column to sensor_readings if a database from an older version lacks it
+int ensure_column(sqlite3 *db, const char *name, const char *type) {
+    if (trace_has_column(db, name)) return 0;
+
+    char sql[128];
+    char *err_msg = 0;
+    snprintf(sql, sizeof(sql), "ALTER TABLE sensor_readings ADD COLUMN %s %s;", name, type);
+    if (sqlite3_exec(db, sql, 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "Failed to add column %s: %s\n", name, err_msg);
+        sqlite3_free(err_msg);
+        return -1;
+    }
+    return 0;
+}
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--rate READINGS_PER_SECOND] [--duration SECONDS]\n", program);
+    fprintf(stderr, "  --rate      Soak-test mode: write at this rate instead of every 10 seconds\n");
+    fprintf(stderr, "  --duration  Stop after this many seconds (default: run until Ctrl+C)\n");
+}
+
+int main(int argc, char *argv[]) {
     sqlite3 *db;
     char *err_msg = 0;
     int rc;
-    char sql[256];
-    
+    double rate = DEFAULT_RATE;
+    double duration = 0;
+    int soak_mode = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+            soak_mode = 1;
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = atof(argv[++i]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (rate <= 0 || duration < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
     // First, ensure the database file exists and is writable
     FILE *f = fopen("sensor_data.db", "a+");
     if (!f) {
@@ -28,7 +93,7 @@ int main() {
         return 1;
     }
     fclose(f);
-    
+
     // Open database with WAL mode for better concurrency
     int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX;
     rc = sqlite3_open_v2("sensor_data.db", &db, flags, NULL);
@@ -37,28 +102,32 @@ int main() {
         if (db) sqlite3_close(db);
         return 1;
     }
-    
+
     // Enable WAL mode for better concurrency
     rc = sqlite3_exec(db, "PRAGMA journal_mode=WAL;", 0, 0, &err_msg);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Failed to set WAL mode: %s\n", err_msg);
         sqlite3_free(err_msg);
     }
-    
+
     rc = sqlite3_exec(db, "PRAGMA synchronous=NORMAL;", 0, 0, &err_msg);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Failed to set synchronous mode: %s\n", err_msg);
         sqlite3_free(err_msg);
     }
-    
-    const char *create_table_sql = 
+
+    // seq, gen_time_us and insert_time_us trace each reading from generation to display
+    const char *create_table_sql =
         "CREATE TABLE IF NOT EXISTS sensor_readings ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "timestamp DATETIME NOT NULL,"
         "temperature FLOAT NOT NULL,"
         "humidity FLOAT NOT NULL,"
-        "illuminance FLOAT NOT NULL);";
-    
+        "illuminance FLOAT NOT NULL,"
+        "seq INTEGER,"
+        "gen_time_us INTEGER,"
+        "insert_time_us INTEGER);";
+
     rc = sqlite3_exec(db, create_table_sql, 0, 0, &err_msg);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "SQL error: %s\n", err_msg);
@@ -66,39 +135,110 @@ int main() {
         sqlite3_close(db);
         return 1;
     }
-    
-    printf("Starting sensor data simulation...\n");
-    printf("Press Ctrl+C to stop\n");
-    
-    srand(time(NULL));
-    
-    while (1) {
-        char timestamp[20];
-        float temperature, humidity, illuminance;
-        
-        get_current_timestamp(timestamp, sizeof(timestamp));
-        
-        temperature = 20.0f + random_float(-5.0f, 5.0f);
-        humidity = 50.0f + random_float(-10.0f, 10.0f);
-        illuminance = 500.0f + random_float(-200.0f, 200.0f);
-        
-        snprintf(sql, sizeof(sql),
-                 "INSERT INTO sensor_readings (timestamp, temperature, humidity, illuminance) "
-                 "VALUES ('%s', %.2f, %.2f, %.2f);",
-                 timestamp, temperature, humidity, illuminance);
-        
-        rc = sqlite3_exec(db, sql, 0, 0, &err_msg);
+
+    // Earlier versions called insert_time_us commit_time_us, though it was stamped as the
+    // insert started; the writer measures actual commit latency itself
+    if (trace_has_column(db, "commit_time_us") && !trace_has_column(db, "insert_time_us")) {
+        rc = sqlite3_exec(db, "ALTER TABLE sensor_readings RENAME COLUMN commit_time_us TO insert_time_us;",
+                          0, 0, &err_msg);
         if (rc != SQLITE_OK) {
-            fprintf(stderr, "SQL error: %s\n", err_msg);
+            fprintf(stderr, "Failed to rename commit_time_us: %s\n", err_msg);
             sqlite3_free(err_msg);
-        } else {
-            printf("Data recorded: %s - Temp: %.1f°C, Hum: %.1f%%, Lux: %.0f\n", 
-                   timestamp, temperature, humidity, illuminance);
         }
-        
-        sleep(10);
     }
-    
+
+    if (ensure_column(db, "seq", "INTEGER") != 0 ||
+        ensure_column(db, "gen_time_us", "INTEGER") != 0 ||
+        ensure_column(db, "insert_time_us", "INTEGER") != 0) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    // Writes go through a queue that rides out locks held by readers and checkpoints
+    static SensorWriter writer;
+    if (writer_open(&writer, db, JOURNAL_PATH) != 0) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    // Continue the sequence from the previous run, including readings still in the journal
+    long long seq = writer.journal_last_seq;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT MAX(seq) FROM sensor_readings;", -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int64(stmt, 0) > seq) {
+            seq = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+
+    signal(SIGINT, handle_stop);
+    signal(SIGTERM, handle_stop);
+
+    if (soak_mode) {
+        printf("Starting soak test: %.1f readings/s", rate);
+        if (duration > 0) printf(" for %.0f seconds", duration);
+        printf("\n");
+    } else {
+        printf("Starting sensor data simulation...\n");
+    }
+    printf("Press Ctrl+C to stop\n");
+
+    srand(time(NULL));
+
+    long long interval_us = (long long)(1000000.0 / rate);
+    long long start_us = trace_now_us();
+    long long next_us = start_us;
+    long long last_report_us = start_us;
+
+    while (!stop_requested && (duration == 0 || trace_now_us() - start_us < (long long)(duration * 1000000.0))) {
+        PendingReading reading;
+
+        reading.gen_us = trace_now_us();
+        reading.seq = ++seq;
+        get_current_timestamp(reading.timestamp, sizeof(reading.timestamp));
+
+        reading.temperature = 20.0f + random_float(-5.0f, 5.0f);
+        reading.humidity = 50.0f + random_float(-10.0f, 10.0f);
+        reading.illuminance = 500.0f + random_float(-200.0f, 200.0f);
+
+        writer_submit(&writer, &reading);
+        if (!soak_mode) {
+            printf("Data recorded: %s - Temp: %.1f°C, Hum: %.1f%%, Lux: %.0f",
+                   reading.timestamp, reading.temperature, reading.humidity, reading.illuminance);
+            if (writer_pending(&writer) > 0) printf(" (%lld waiting to be written)", writer_pending(&writer));
+            printf("\n");
+        }
+
+        if (soak_mode && trace_now_us() - last_report_us >= SOAK_REPORT_INTERVAL * 1000000LL) {
+            last_report_us = trace_now_us();
+            printf("Soak: %lld written, %.1f readings/s, seq %lld, %d queued, %lld journaled, %lld retries\n",
+                   writer.stats.written, writer.stats.written / ((last_report_us - start_us) / 1e6), seq,
+                   writer.queue_depth, writer_pending(&writer) - writer.queue_depth, writer.stats.retries);
+            fflush(stdout);
+        }
+
+        // Pace against a fixed schedule so write time doesn't lower the rate,
+        // working through any backlog while waiting for the next reading
+        next_us += interval_us;
+        while (!stop_requested && trace_now_us() < next_us) {
+            long long wake = next_us;
+            if (writer_flush(&writer) > 0 && writer_next_attempt_us(&writer) < wake) {
+                wake = writer_next_attempt_us(&writer);
+            }
+            sleep_until_us(wake);
+        }
+    }
+
+    // Give the backlog a last chance before leaving it in the journal for the next run
+    long long drain_deadline = trace_now_us() + SHUTDOWN_DRAIN_TIME * 1000000LL;
+    while (writer_pending(&writer) > 0 && trace_now_us() < drain_deadline) {
+        if (writer_flush(&writer) > 0) sleep_until_us(writer_next_attempt_us(&writer));
+    }
+    writer_close(&writer);
+
+    if (soak_mode) printf("Soak finished: ");
+    writer_report(&writer, stdout);
+
     sqlite3_close(db);
     return 0;
 }
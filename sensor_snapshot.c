@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sensor_snapshot.h"
+
+#define SNAPSHOT_MAGIC "SNSRSNAP"
+#define SNAPSHOT_VERSION 3
+
+// On-disk layout: header followed by `count` SensorReading records (native byte order,
+// the snapshot is a local cache and is simply discarded if it doesn't match)
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    int32_t count;
+    int32_t reserved;
+    int64_t last_id;
+    double last_timestamp;
+} SnapshotHeader;
+
+int snapshot_save(const char *path, const SensorReading *readings, int count, long long last_id) {
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.record_size = sizeof(SensorReading);
+    header.count = count;
+    header.last_id = last_id;
+    header.last_timestamp = count > 0 ? readings[count-1].timestamp : 0;
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (!f) {
+        perror("Failed to write snapshot");
+        return -1;
+    }
+
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (ok && count > 0) {
+        ok = fwrite(readings, sizeof(SensorReading), count, f) == (size_t)count;
+    }
+    if (fclose(f) != 0) ok = 0;
+
+    // Rename over the old snapshot so a crash mid-write never leaves a torn file
+    if (!ok || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Failed to write snapshot %s\n", path);
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int snapshot_load(const char *path, SensorReading *readings, int capacity, SnapshotInfo *info) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    const SnapshotHeader *header = (const SnapshotHeader *)map;
+    const SensorReading *records = (const SensorReading *)(header + 1);
+    int restored = -1;
+
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == SNAPSHOT_VERSION &&
+        header->record_size == sizeof(SensorReading) &&
+        header->count >= 0 &&
+        (size_t)st.st_size >= sizeof(SnapshotHeader) + (size_t)header->count * sizeof(SensorReading)) {
+
+        // Keep the newest readings if the snapshot was written with a larger window
+        int skip = header->count > capacity ? header->count - capacity : 0;
+        restored = header->count - skip;
+        memcpy(readings, records + skip, restored * sizeof(SensorReading));
+
+        if (info) {
+            info->last_id = header->last_id;
+            info->last_timestamp = header->last_timestamp;
+        }
+    } else {
+        fprintf(stderr, "Ignoring invalid snapshot %s\n", path);
+    }
+
+    munmap(map, st.st_size);
+    return restored;
+}
+
+int snapshot_matches_database(sqlite3 *db, long long last_id, const SensorReading *newest) {
+    sqlite3_stmt *stmt;
+    int matches = 0;
+    const char *sql = "SELECT strftime('%s', timestamp), temperature, humidity, illuminance "
+                      "FROM sensor_readings WHERE id = ?;";
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, 0) != SQLITE_OK) return 0;
+    sqlite3_bind_int64(stmt, 1, last_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        // Compared the way the loaders convert the columns
+        matches = sqlite3_column_double(stmt, 0) == newest->timestamp &&
+                  (float)sqlite3_column_double(stmt, 1) == newest->temperature &&
+                  (float)sqlite3_column_double(stmt, 2) == newest->humidity &&
+                  (float)sqlite3_column_double(stmt, 3) == newest->illuminance;
+    }
+    sqlite3_finalize(stmt);
+    return matches;
+}
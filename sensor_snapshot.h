@@ -0,0 +1,24 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <sqlite3.h>
+#include "sensor_reading.h"
+
+// Metadata restored alongside the readings
+typedef struct {
+    long long last_id;          // Highest sensor_readings.id contained in the window
+    double last_timestamp;      // Timestamp of the newest reading in the window
+} SnapshotInfo;
+
+// Write the window atomically (temp file + rename). Returns 0 on success, -1 on failure.
+int snapshot_save(const char *path, const SensorReading *readings, int count, long long last_id);
+
+// Map a snapshot and copy up to `capacity` of its newest readings into `readings`.
+// Returns the number of readings restored, or -1 if the file is missing or invalid.
+int snapshot_load(const char *path, SensorReading *readings, int capacity, SnapshotInfo *info);
+
+// Check that the row at the snapshot's cursor id is still its newest reading, i.e. the
+// database wasn't recreated since the snapshot was written. Returns 1 if it matches.
+int snapshot_matches_database(sqlite3 *db, long long last_id, const SensorReading *newest);
+
+#endif
@@ -4,6 +4,11 @@
 #include <time.h>
 #include <math.h>
 #include <raylib.h>
+#include "sensor_reading.h"
+#include "sensor_snapshot.h"
+#include "render_cache.h"
+#include "latency_trace.h"
+#include "resample.h"
 
 #define MAX_READINGS 100
 #define WINDOW_WIDTH  1000
@@ -16,125 +21,180 @@
 #define TITLE_OFFSET 25
 #define TIME_LABEL_OFFSET 25    // Space below graph for time labels
 #define Y_LABEL_WIDTH 20        // Width for Y-axis labels
-
-typedef struct {
-    double timestamp;
-    float temperature;
-    float humidity;
-    float illuminance;
-} SensorReading;
+#define LOAD_BATCH_SIZE 64      // Max rows fetched per poll while catching up
+#define SNAPSHOT_PATH "sensor_visualizer.snap"
+#define SNAPSHOT_INTERVAL 30.0  // Seconds between periodic snapshot saves
+#define TRACE_REPORT_INTERVAL 60.0  // Seconds between latency reports on stdout
+#define ACTIVE_FPS 60           // Frame rate right after something changed
+#define IDLE_FPS 10             // Frame rate while nothing changes
+#define ACTIVE_PERIOD 1.0       // Seconds to stay at ACTIVE_FPS after a change
 
 SensorReading readings[MAX_READINGS];
 int reading_count = 0;
-double last_reading_timestamp = 0;
+long long last_reading_id = 0;      // Cursor: highest sensor_readings.id in the window
+long long saved_reading_id = 0;     // Cursor stored in the last snapshot written
+unsigned int data_version = 0;      // Bumped whenever the readings change
+
+// Generation-to-screen latency of readings appended while running
+LatencyTrace latency;
+int trace_enabled = 0;              // Database has the seq/gen_time_us/insert_time_us columns
+
+// The window on a uniform time grid, rebuilt when the readings change
+ResampleConfig plot_config;
+ResampledGrid plot_grid;
+
+// Append a reading, dropping the oldest one when the buffer is full
+static void append_reading(const SensorReading *reading) {
+    if (reading_count >= MAX_READINGS) {
+        for (int i = 1; i < reading_count; i++) {
+            readings[i-1] = readings[i];
+        }
+        reading_count--;
+    }
+    readings[reading_count++] = *reading;
+}
 
-void load_sensor_data(sqlite3 *db) {
+// Fetch readings newer than the cursor. Rows are addressed by the INTEGER PRIMARY KEY so
+// neither the MAX lookup nor the range scan touches the unindexed timestamp column.
+// Returns 1 if more rows are pending after this batch.
+int load_sensor_data(sqlite3 *db) {
     sqlite3_stmt *stmt;
-    const char *sql;
+    char sql[512];
     int rc;
     int new_readings = 0;
+    int initial_load;
     
-    // First, get the latest timestamp from the database
-    double latest_db_timestamp = 0;
-    const char *latest_ts_sql = "SELECT strftime('%s', MAX(timestamp)) FROM sensor_readings;";
+    // First, get the latest row id from the database
+    long long latest_db_id = 0;
+    const char *latest_id_sql = "SELECT MAX(id) FROM sensor_readings;";
     
-    rc = sqlite3_prepare_v2(db, latest_ts_sql, -1, &stmt, 0);
+    rc = sqlite3_prepare_v2(db, latest_id_sql, -1, &stmt, 0);
     if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
-        latest_db_timestamp = sqlite3_column_double(stmt, 0);
+        latest_db_id = sqlite3_column_int64(stmt, 0);
     }
     sqlite3_finalize(stmt);
     
     // If no new data, return early
-    if (latest_db_timestamp <= last_reading_timestamp) {
-        return;
+    if (latest_db_id == last_reading_id) {
+        return 0;
     }
     
-    // If we have previous readings, only fetch new ones
-    if (reading_count > 0) {
-        sql = "SELECT strftime('%s', timestamp) as ts, temperature, humidity, illuminance "
-              "FROM sensor_readings WHERE timestamp > datetime(?, 'unixepoch') "
-              "ORDER BY timestamp ASC";
+    // Reload the whole window on first start, if the database was recreated, or if the
+    // delta since the cursor is larger than the window anyway
+    initial_load = reading_count == 0 || latest_db_id < last_reading_id ||
+                   latest_db_id - last_reading_id > MAX_READINGS;
+    
+    // Trace columns are selected as NULL on databases written by an older simulator
+    const char *trace_columns = trace_enabled ? "seq, gen_time_us, insert_time_us" : "NULL, NULL, NULL";
+    if (initial_load) {
+        snprintf(sql, sizeof(sql),
+                 "SELECT id, strftime('%%s', timestamp) as ts, temperature, humidity, illuminance, %s "
+                 "FROM (SELECT * FROM sensor_readings ORDER BY id DESC LIMIT ?) ORDER BY id ASC", trace_columns);
     } else {
-        sql = "SELECT strftime('%s', timestamp) as ts, temperature, humidity, illuminance "
-              "FROM sensor_readings ORDER BY timestamp DESC LIMIT ?";
+        snprintf(sql, sizeof(sql),
+                 "SELECT id, strftime('%%s', timestamp) as ts, temperature, humidity, illuminance, %s "
+                 "FROM sensor_readings WHERE id > ? ORDER BY id ASC LIMIT ?", trace_columns);
     }
     
     rc = sqlite3_prepare_v2(db, sql, -1, &stmt, 0);
     if (rc != SQLITE_OK) {
         fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        return;
+        return 0;
     }
     
-    if (reading_count > 0) {
-        sqlite3_bind_double(stmt, 1, last_reading_timestamp);
-    } else {
+    if (initial_load) {
         sqlite3_bind_int(stmt, 1, MAX_READINGS);
+    } else {
+        sqlite3_bind_int64(stmt, 1, last_reading_id);
+        sqlite3_bind_int(stmt, 2, LOAD_BATCH_SIZE);
     }
     
-    // If we're adding to existing readings, shift old readings to make room for new ones
-    if (reading_count > 0) {
-        // Remove unused variable
+    if (!initial_load) {
         while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-            double ts = sqlite3_column_double(stmt, 0);
-            if (ts <= last_reading_timestamp) continue;
+            SensorReading reading;
+            last_reading_id = sqlite3_column_int64(stmt, 0);
+            reading.timestamp = sqlite3_column_double(stmt, 1);
+            reading.gen_time = sqlite3_column_type(stmt, 6) != SQLITE_NULL
+                             ? sqlite3_column_int64(stmt, 6) / 1e6 : 0;
+            reading.temperature = sqlite3_column_double(stmt, 2);
+            reading.humidity = sqlite3_column_double(stmt, 3);
+            reading.illuminance = sqlite3_column_double(stmt, 4);
+            append_reading(&reading);
             
-            // If buffer is full, remove oldest reading
-            if (reading_count >= MAX_READINGS) {
-                for (int i = 1; i < reading_count; i++) {
-                    readings[i-1] = readings[i];
-                }
-                reading_count--;
+            if (sqlite3_column_type(stmt, 6) != SQLITE_NULL) {
+                trace_loaded(&latency, sqlite3_column_int64(stmt, 5),
+                             sqlite3_column_int64(stmt, 6), sqlite3_column_int64(stmt, 7));
             }
             
-            // Add new reading at the end
-            readings[reading_count].timestamp = ts;
-            readings[reading_count].temperature = sqlite3_column_double(stmt, 1);
-            readings[reading_count].humidity = sqlite3_column_double(stmt, 2);
-            readings[reading_count].illuminance = sqlite3_column_double(stmt, 3);
-            
             // Log the new reading
-            time_t t = (time_t)ts;
+            time_t t = (time_t)reading.timestamp;
             struct tm *timeinfo = localtime(&t);
             char time_str[20];
             strftime(time_str, sizeof(time_str), "%H:%M:%S", timeinfo);
             
             printf("[%s] New reading: %.1f°C, %.1f%%, %.0f lux\n", 
                    time_str,
-                   readings[reading_count].temperature,
-                   readings[reading_count].humidity,
-                   readings[reading_count].illuminance);
+                   reading.temperature,
+                   reading.humidity,
+                   reading.illuminance);
             
-            reading_count++;
             new_readings++;
         }
     } else {
-        // Initial load
+        // Full reload, oldest first. Rows past the previous cursor are new since the last
+        // poll, so they are traced like appended ones; readings skipped over count as gaps.
+        long long previous_id = latest_db_id > last_reading_id ? last_reading_id : 0;
         reading_count = 0;
+        last_reading_id = 0;
         while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && reading_count < MAX_READINGS) {
-            readings[reading_count].timestamp = sqlite3_column_double(stmt, 0);
-            readings[reading_count].temperature = sqlite3_column_double(stmt, 1);
-            readings[reading_count].humidity = sqlite3_column_double(stmt, 2);
-            readings[reading_count].illuminance = sqlite3_column_double(stmt, 3);
+            last_reading_id = sqlite3_column_int64(stmt, 0);
+            if (previous_id > 0 && last_reading_id > previous_id &&
+                sqlite3_column_type(stmt, 6) != SQLITE_NULL) {
+                trace_loaded(&latency, sqlite3_column_int64(stmt, 5),
+                             sqlite3_column_int64(stmt, 6), sqlite3_column_int64(stmt, 7));
+            }
+            readings[reading_count].timestamp = sqlite3_column_double(stmt, 1);
+            readings[reading_count].gen_time = sqlite3_column_type(stmt, 6) != SQLITE_NULL
+                                             ? sqlite3_column_int64(stmt, 6) / 1e6 : 0;
+            readings[reading_count].temperature = sqlite3_column_double(stmt, 2);
+            readings[reading_count].humidity = sqlite3_column_double(stmt, 3);
+            readings[reading_count].illuminance = sqlite3_column_double(stmt, 4);
             reading_count++;
         }
         printf("Initial load: %d readings.\n", reading_count);
     }
     
+    if (initial_load || new_readings > 0) {
+        data_version++;
+    }
+    
     if (rc != SQLITE_DONE) {
         fprintf(stderr, "Error during query execution: %s\n", sqlite3_errmsg(db));
     } else if (new_readings > 0) {
         printf("Added %d new readings. Total: %d\n", new_readings, reading_count);
     }
     
-    // Update the last known timestamp
-    if (reading_count > 0) {
-        last_reading_timestamp = readings[reading_count-1].timestamp;
-    }
-    
     sqlite3_finalize(stmt);
+    
+    return !initial_load && new_readings == LOAD_BATCH_SIZE;
+}
+
+// Persist the window so the next start can render without waiting for the database
+void save_snapshot(void) {
+    if (last_reading_id == saved_reading_id) return;
+    if (snapshot_save(SNAPSHOT_PATH, readings, reading_count, last_reading_id) == 0) {
+        saved_reading_id = last_reading_id;
+    }
 }
 
-void draw_graph(float *values, int count, int graph_index, float min_val, float max_val, Color color, const char* title) {
+// Screen area of a graph panel, including its title and time labels
+Rectangle graph_panel_bounds(int graph_index) {
+    float graph_y = GRAPH_TOP_MARGIN + graph_index * (GRAPH_HEIGHT + GRAPH_MARGIN);
+    return (Rectangle){ 0, graph_y - TITLE_OFFSET, WINDOW_WIDTH, GRAPH_HEIGHT };
+}
+
+// Parts of a graph that only depend on its fixed range: title, background, grid, Y labels
+void draw_graph_chrome(int graph_index, float min_val, float max_val, Color color, const char* title) {
     // Calculate graph position
     float graph_x = GRAPH_LEFT_MARGIN + Y_LABEL_WIDTH;  // Add space for Y labels
     float graph_y = GRAPH_TOP_MARGIN + graph_index * (GRAPH_HEIGHT + GRAPH_MARGIN);
@@ -150,15 +210,6 @@ void draw_graph(float *values, int count, int graph_index, float min_val, float
     // Draw border
     DrawRectangleLines(graph_x, graph_y, graph_width, graph_height, LIGHTGRAY);
     
-    if (count < 2) {
-        DrawText("Not enough data points", graph_x + 20, graph_y + 40, 14, GRAY);
-        return;
-    }
-    
-    // Calculate scales
-    float x_scale = (graph_width - 20) / (count - 1);
-    float y_scale = (graph_height - 20) / (max_val - min_val);
-    
     // Draw grid lines and Y-axis labels
     for (int i = 0; i <= 5; i++) {
         float value = min_val + (max_val - min_val) * (1.0f - (float)i / 5);
@@ -173,58 +224,98 @@ void draw_graph(float *values, int count, int graph_index, float min_val, float
         int text_width = MeasureText(value_text, 12);
         DrawText(value_text, GRAPH_LEFT_MARGIN + Y_LABEL_WIDTH - text_width - 5, y - 8, 12, DARKGRAY);
     }
+}
+
+// Data-dependent parts of a graph: time labels, line and points. Points are placed by
+// time on the resampled grid; the line breaks across gaps in the data.
+void draw_graph_data(const ResampledGrid *grid, int channel, int graph_index, float min_val, float max_val, Color color) {
+    // Calculate graph position
+    float graph_x = GRAPH_LEFT_MARGIN + Y_LABEL_WIDTH;  // Add space for Y labels
+    float graph_y = GRAPH_TOP_MARGIN + graph_index * (GRAPH_HEIGHT + GRAPH_MARGIN);
+    float graph_width = WINDOW_WIDTH - GRAPH_LEFT_MARGIN - GRAPH_MARGIN - Y_LABEL_WIDTH;
+    float graph_height = GRAPH_HEIGHT - GRAPH_BOTTOM_MARGIN;
+    int bins = grid->bins;
     
-    // Draw X-axis labels (time)
-    if (count > 1) {
-        // X-axis label (time) - moved below graph, adjusted to KST (+9 hours)
-        time_t first_time = (time_t)readings[0].timestamp + (9 * 3600);  // Add 9 hours for KST
-        struct tm *tm_info = gmtime(&first_time);  // Use gmtime since we've already adjusted the time
-        char time_buf[20];
-        strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
-        DrawText(time_buf, graph_x + 5, graph_y + graph_height + 5, 12, DARKGRAY);
-        
-        // Last point time
-        time_t last_time = (time_t)readings[count-1].timestamp + (9 * 3600);  // Add 9 hours for KST
-        tm_info = gmtime(&last_time);
+    if (bins < 2) {
+        DrawText("Not enough data points", graph_x + 20, graph_y + 40, 14, GRAY);
+        return;
+    }
+    
+    // Calculate scales
+    float x_scale = (graph_width - 20) / (bins - 1);
+    float y_scale = (graph_height - 20) / (max_val - min_val);
+    
+    // X-axis labels (time) below the graph, adjusted to KST (+9 hours)
+    time_t first_time = (time_t)resample_bin_time(grid, 0) + (9 * 3600);  // Add 9 hours for KST
+    struct tm *tm_info = gmtime(&first_time);  // Use gmtime since we've already adjusted the time
+    char time_buf[20];
+    strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
+    DrawText(time_buf, graph_x + 5, graph_y + graph_height + 5, 12, DARKGRAY);
+    
+    // Last point time
+    time_t last_time = (time_t)resample_bin_time(grid, bins - 1) + (9 * 3600);
+    tm_info = gmtime(&last_time);
+    strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
+    int text_width = MeasureText(time_buf, 12);
+    DrawText(time_buf, graph_x + graph_width - text_width - 5, graph_y + graph_height + 5, 12, DARKGRAY);
+    
+    // Middle of the time axis for better reference
+    if (bins > 2) {
+        time_t mid_time = (time_t)(grid->start + (bins - 1) * grid->step / 2) + (9 * 3600);
+        tm_info = gmtime(&mid_time);
         strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
-        int text_width = MeasureText(time_buf, 12);
-        DrawText(time_buf, graph_x + graph_width - text_width - 5, graph_y + graph_height + 5, 12, DARKGRAY);
-        
-        // Optional: Add a middle time point for better reference
-        if (count > 2) {
-            int mid = count / 2;
-            time_t mid_time = (time_t)readings[mid].timestamp + (9 * 3600);  // Add 9 hours for KST
-            tm_info = gmtime(&mid_time);
-            strftime(time_buf, sizeof(time_buf), "%H:%M:%S", tm_info);
-            text_width = MeasureText(time_buf, 12);
-            DrawText(time_buf, graph_x + (graph_width - text_width) / 2, graph_y + graph_height + 5, 12, DARKGRAY);
-        }
+        text_width = MeasureText(time_buf, 12);
+        DrawText(time_buf, graph_x + (graph_width - text_width) / 2, graph_y + graph_height + 5, 12, DARKGRAY);
     }
     
-    // Draw graph line
-    for (int i = 0; i < count - 1; i++) {
-        float x1 = graph_x + 10 + i * x_scale;
-        float y1 = graph_y + graph_height - 10 - (values[i] - min_val) * y_scale;
-        float x2 = graph_x + 10 + (i + 1) * x_scale;
-        float y2 = graph_y + graph_height - 10 - (values[i + 1] - min_val) * y_scale;
+    // Draw graph line through observed and interpolated bins, breaking at gaps
+    Vector2 prev = {0};
+    int has_prev = 0;
+    for (int i = 0; i < bins; i++) {
+        if (grid->mask[i] == RESAMPLE_GAP) {
+            has_prev = 0;
+            continue;
+        }
+        if (!resample_has_value(grid, i)) continue;
+        
+        float x = graph_x + 10 + i * x_scale;
+        float y = graph_y + graph_height - 10 - (grid->values[channel][i] - min_val) * y_scale;
         
         // Clamp y values to graph bounds
-        y1 = (y1 < graph_y + 10) ? graph_y + 10 : (y1 > graph_y + graph_height - 10) ? graph_y + graph_height - 10 : y1;
-        y2 = (y2 < graph_y + 10) ? graph_y + 10 : (y2 > graph_y + graph_height - 10) ? graph_y + graph_height - 10 : y2;
+        y = (y < graph_y + 10) ? graph_y + 10 : (y > graph_y + graph_height - 10) ? graph_y + graph_height - 10 : y;
         
-        // Draw line segment
-        DrawLineEx((Vector2){x1, y1}, (Vector2){x2, y2}, 2.0f, color);
+        if (has_prev) {
+            DrawLineEx(prev, (Vector2){x, y}, 2.0f, color);
+        }
+        
+        // Draw data point where there was a reading
+        if (grid->mask[i] == RESAMPLE_OBSERVED) {
+            DrawCircle(x, y, 2.0f, color);
+        }
+        prev = (Vector2){x, y};
+        has_prev = 1;
+    }
+}
+
+// Header line with the most recent reading
+void draw_latest_values(void) {
+    if (reading_count > 0) {
+        char text[128];
+        int latest = reading_count - 1;
         
-        // Draw data point
-        DrawCircle(x1, y1, 2.0f, color);
+        sprintf(text, "Latest: Temp: %.1f°C, Hum: %.1f%%, Lux: %.0f",
+               readings[latest].temperature, 
+               readings[latest].humidity, 
+               readings[latest].illuminance);
+        DrawText(text, 10, 10, 18, DARKGRAY);
     }
     
-    // Draw the last point
-    if (count > 0) {
-        float x = graph_x + 10 + (count - 1) * x_scale;
-        float y = graph_y + graph_height - 10 - (values[count - 1] - min_val) * y_scale;
-        y = (y < graph_y + 10) ? graph_y + 10 : (y > graph_y + graph_height - 10) ? graph_y + graph_height - 10 : y;
-        DrawCircle(x, y, 2.0f, color);
+    // How stale the newest readings were when they reached the screen
+    if (latency.traced > 0) {
+        char text[128];
+        snprintf(text, sizeof(text), "Generate->draw latency: p50 %.0f ms, p99 %.0f ms (%lld readings)",
+                 trace_gen_to_draw_ms(&latency, 0.50f), trace_gen_to_draw_ms(&latency, 0.99f), latency.traced);
+        DrawText(text, 10, 34, 14, GRAY);
     }
 }
 
@@ -263,21 +354,6 @@ int main() {
     sqlite3_finalize(stmt);
     printf("sensor_readings table found.\n");
     
-    // Count the number of rows
-    const char *count_sql = "SELECT COUNT(*) FROM sensor_readings;";
-    rc = sqlite3_prepare_v2(db, count_sql, -1, &stmt, 0);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to count rows: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return 1;
-    }
-    
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        int row_count = sqlite3_column_int(stmt, 0);
-        printf("Found %d rows in sensor_readings table.\n", row_count);
-    }
-    sqlite3_finalize(stmt);
-    
     // Enable WAL mode for better concurrency
     char *err_msg = 0;
     rc = sqlite3_exec(db, "PRAGMA journal_mode=WAL;", 0, 0, &err_msg);
@@ -288,74 +364,136 @@ int main() {
     
     // Initialize window
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Sensor Data Visualizer");
-    SetTargetFPS(60);
+    SetTargetFPS(ACTIVE_FPS);
+    
+    // Fixed ranges for scaling
+    const char *titles[SENSOR_CHANNEL_COUNT] = { "Temperature (°C)", "Humidity (%)", "Illuminance (lux)" };
+    const Color colors[SENSOR_CHANNEL_COUNT] = { RED, BLUE, DARKGREEN };
+    const float min_vals[SENSOR_CHANNEL_COUNT] = { 15, 20, 0 };     // Typical temperature/humidity/illuminance ranges
+    const float max_vals[SENSOR_CHANNEL_COUNT] = { 35, 80, 1000 };
+    
+    trace_init(&latency);
+    trace_enabled = trace_columns_available(db);
+    
+    // Restore the last window from the snapshot so the first frame doesn't wait on SQLite
+    SnapshotInfo snapshot;
+    int restored = snapshot_load(SNAPSHOT_PATH, readings, MAX_READINGS, &snapshot);
+    if (restored > 0 && !snapshot_matches_database(db, snapshot.last_id, &readings[restored - 1])) {
+        printf("Snapshot doesn't match the database, loading from scratch.\n");
+        restored = 0;
+    }
+    if (restored > 0) {
+        reading_count = restored;
+        last_reading_id = saved_reading_id = snapshot.last_id;
+        printf("Warm start: %d readings from snapshot (cursor id %lld).\n", reading_count, last_reading_id);
+    } else {
+        // Cold start: load initial data before the first frame
+        load_sensor_data(db);
+    }
     
-    // Find min/max values for scaling
-    float min_temp = 15, max_temp = 35;      // Typical temperature range
-    float min_humidity = 20, max_humidity = 80;  // Typical humidity range
-    float min_lux = 0, max_lux = 1000;       // Typical illuminance range
+    // Cached layers: a header strip with the latest values and one panel per graph.
+    // The frame itself only blits them; they are re-rendered when the data changes.
+    CachedPanel header;
+    CachedPanel graphs[SENSOR_CHANNEL_COUNT];
+    panel_init(&header, (Rectangle){ 0, 0, WINDOW_WIDTH, GRAPH_TOP_MARGIN - TITLE_OFFSET });
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        panel_init(&graphs[i], graph_panel_bounds(i));
+    }
+    unsigned int rendered_version = data_version;
+    resample_default_config(&plot_config);
+    resample_readings(readings, reading_count, &plot_config, &plot_grid);
     
-    // Load initial data
-    load_sensor_data(db);
+    double lastUpdate = GetTime();
+    double lastSnapshot = lastUpdate;
+    double lastTraceReport = lastUpdate;
+    double lastChange = lastUpdate;
+    int currentFps = ACTIVE_FPS;
+    int catching_up = restored > 0;
     
     // Main game loop
     while (!WindowShouldClose()) {
-        // Reload data every second
-        static double lastUpdate = 0;
-        double currentTime = GetTime();
-        if (currentTime - lastUpdate >= 1.0) {
-            load_sensor_data(db);
-            lastUpdate = currentTime;
+        if (data_version != rendered_version) {
+            header.layer_dirty = 1;
+            for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+                graphs[i].layer_dirty = 1;
+            }
+            rendered_version = data_version;
+            resample_readings(readings, reading_count, &plot_config, &plot_grid);
         }
         
-        BeginDrawing();
-        ClearBackground(RAYWHITE);
-        
-        // Draw temperature graph (graph_index = 0)
-        if (reading_count > 0) {
-            float temp_values[MAX_READINGS];
-            for (int i = 0; i < reading_count; i++) {
-                temp_values[i] = readings[i].temperature;
-            }
-            draw_graph(temp_values, reading_count, 0, min_temp, max_temp, RED, "Temperature (°C)");
+        // Re-render dirty layers
+        int redrawn = header.layer_dirty;
+        if (header.chrome_dirty) {
+            panel_begin_chrome(&header, RAYWHITE);
+            panel_end_chrome(&header);
+        }
+        if (header.layer_dirty) {
+            panel_begin_layer(&header);
+            draw_latest_values();
+            panel_end_layer(&header);
         }
         
-        // Draw humidity graph (graph_index = 1)
-        if (reading_count > 0) {
-            float hum_values[MAX_READINGS];
-            for (int i = 0; i < reading_count; i++) {
-                hum_values[i] = readings[i].humidity;
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            if (graphs[i].chrome_dirty) {
+                panel_begin_chrome(&graphs[i], RAYWHITE);
+                draw_graph_chrome(i, min_vals[i], max_vals[i], colors[i], titles[i]);
+                panel_end_chrome(&graphs[i]);
+            }
+            if (graphs[i].layer_dirty) {
+                panel_begin_layer(&graphs[i]);
+                draw_graph_data(&plot_grid, i, i, min_vals[i], max_vals[i], colors[i]);
+                panel_end_layer(&graphs[i]);
+                redrawn = 1;
             }
-            draw_graph(hum_values, reading_count, 1, min_humidity, max_humidity, BLUE, "Humidity (%)");
         }
         
-        // Draw illuminance graph (graph_index = 2)
-        if (reading_count > 0) {
-            float lux_values[MAX_READINGS];
-            for (int i = 0; i < reading_count; i++) {
-                lux_values[i] = readings[i].illuminance;
-            }
-            draw_graph(lux_values, reading_count, 2, min_lux, max_lux, DARKGREEN, "Illuminance (lux)");
+        BeginDrawing();
+        ClearBackground(RAYWHITE);
+        
+        panel_draw(&header);
+        for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+            panel_draw(&graphs[i]);
         }
         
         // Draw FPS in top-right corner
         DrawFPS(WINDOW_WIDTH - 100, 10);
         
-        // Draw current values
-        if (reading_count > 0) {
-            char text[128];
-            int latest = reading_count - 1;
-            
-            sprintf(text, "Latest: Temp: %.1f°C, Hum: %.1f%%, Lux: %.0f",
-                   readings[latest].temperature, 
-                   readings[latest].humidity, 
-                   readings[latest].illuminance);
-            DrawText(text, 10, 10, 18, DARKGRAY);
+        EndDrawing();
+        trace_presented(&latency);
+        
+        // Stay at full rate for a moment after a change, otherwise idle at a low rate
+        double currentTime = GetTime();
+        if (redrawn) lastChange = currentTime;
+        int targetFps = currentTime - lastChange < ACTIVE_PERIOD ? ACTIVE_FPS : IDLE_FPS;
+        if (targetFps != currentFps) {
+            SetTargetFPS(targetFps);
+            currentFps = targetFps;
         }
         
-        EndDrawing();
+        // Poll after presenting the frame: every second, or on the very next frame while
+        // catching up with the delta since the snapshot cursor
+        if (catching_up || currentTime - lastUpdate >= 1.0) {
+            catching_up = load_sensor_data(db);
+            lastUpdate = currentTime;
+        }
+        
+        if (currentTime - lastSnapshot >= SNAPSHOT_INTERVAL) {
+            save_snapshot();
+            lastSnapshot = currentTime;
+        }
+        
+        if (currentTime - lastTraceReport >= TRACE_REPORT_INTERVAL) {
+            trace_report(&latency, stdout);
+            lastTraceReport = currentTime;
+        }
     }
     
+    save_snapshot();
+    trace_report(&latency, stdout);
+    panel_unload(&header);
+    for (int i = 0; i < SENSOR_CHANNEL_COUNT; i++) {
+        panel_unload(&graphs[i]);
+    }
     CloseWindow();
     sqlite3_close(db);
     
@@ -0,0 +1,436 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sensor_writer.h"
+#include "latency_trace.h"
+
+// On-disk journal record: a torn or corrupted record fails the checksum instead of
+// being inserted
+typedef struct {
+    PendingReading reading;
+    uint32_t checksum;
+    uint32_t reserved;
+} JournalRecord;
+
+// Errors that may clear up on their own; anything else would fail again on retry
+static int is_transient(int rc) {
+    switch (rc & 0xff) {
+        case SQLITE_BUSY:
+        case SQLITE_LOCKED:
+        case SQLITE_FULL:
+        case SQLITE_IOERR:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Counts an inserted row in its rollup bucket. Only transient errors are returned: a
+// bucket that can't be written for any other reason is reported and the row kept.
+static int roll_up(SensorWriter *writer, const PendingReading *r) {
+    const float values[SENSOR_CHANNEL_COUNT] = { r->temperature, r->humidity, r->illuminance };
+    int rc = rollup_accumulate(writer->db, &writer->rollup, r->gen_us / 1000000, values);
+    if (rc == SQLITE_OK || is_transient(rc)) return rc;
+    fprintf(stderr, "Rollup error: %s\n", sqlite3_errmsg(writer->db));
+    return SQLITE_OK;
+}
+
+// Undo the transaction; the cached rollup bucket may hold its changes, so drop it too
+static void roll_back(SensorWriter *writer) {
+    sqlite3_exec(writer->db, "ROLLBACK;", 0, 0, 0);
+    rollup_init(&writer->rollup, -1);
+}
+
+// Inserts `count` readings and their rollups in one transaction.
+// Returns SQLITE_OK once the rows are committed, or the transient error that stopped them;
+// rows rejected with a non-transient error are reported and counted in *failed.
+static int insert_rows(SensorWriter *writer, const PendingReading *rows, int count, int *failed) {
+    sqlite3_stmt *stmt = writer->insert_stmt;
+    unsigned char rejected[WRITER_BATCH_SIZE] = {0};
+    int rc;
+
+    *failed = 0;
+    rc = sqlite3_exec(writer->db, "BEGIN IMMEDIATE;", 0, 0, 0);
+    if (rc != SQLITE_OK) return rc;
+
+    for (int i = 0; i < count; i++) {
+        const PendingReading *r = &rows[i];
+        sqlite3_bind_text(stmt, 1, r->timestamp, (int)strnlen(r->timestamp, sizeof(r->timestamp)),
+                          SQLITE_TRANSIENT);
+        sqlite3_bind_double(stmt, 2, r->temperature);
+        sqlite3_bind_double(stmt, 3, r->humidity);
+        sqlite3_bind_double(stmt, 4, r->illuminance);
+        sqlite3_bind_int64(stmt, 5, r->seq);
+        sqlite3_bind_int64(stmt, 6, r->gen_us);
+        // Insert start; commit latency is measured once the rows are durable, below
+        sqlite3_bind_int64(stmt, 7, trace_now_us());
+
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc == SQLITE_DONE) rc = roll_up(writer, r);
+        if (rc == SQLITE_OK) continue;
+
+        if (is_transient(rc)) {
+            roll_back(writer);
+            return rc;
+        }
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(writer->db));
+        rejected[i] = 1;
+        (*failed)++;
+    }
+
+    rc = writer->rollup.start >= 0 ? rollup_store(writer->db, &writer->rollup) : SQLITE_OK;
+    if (rc != SQLITE_OK && is_transient(rc)) {
+        roll_back(writer);
+        return rc;
+    } else if (rc != SQLITE_OK) {
+        fprintf(stderr, "Rollup error: %s\n", sqlite3_errmsg(writer->db));
+    }
+
+    rc = sqlite3_exec(writer->db, "COMMIT;", 0, 0, 0);
+    if (rc != SQLITE_OK) {
+        roll_back(writer);
+        return rc;
+    }
+
+    long long committed_us = trace_now_us();
+    for (int i = 0; i < count; i++) {
+        if (!rejected[i]) sketch_add(&writer->stats.gen_to_commit, (committed_us - rows[i].gen_us) / 1000.0f);
+    }
+    return SQLITE_OK;
+}
+
+static long long journal_pending(const SensorWriter *writer) {
+    return writer->journal_records - writer->journal_replayed;
+}
+
+static int open_journal(SensorWriter *writer) {
+    if (writer->journal) return 0;
+    writer->journal = fopen(writer->journal_path, "a+b");
+    if (!writer->journal) {
+        perror("Failed to open write journal");
+        return -1;
+    }
+    return 0;
+}
+
+// Drop the journal once everything in it is in the database
+static void discard_journal(SensorWriter *writer) {
+    if (writer->journal) fclose(writer->journal);
+    writer->journal = NULL;
+    remove(writer->journal_path);
+    writer->journal_records = 0;
+    writer->journal_replayed = 0;
+    writer->journal_unsynced = 0;
+}
+
+// FNV-1a over the reading's bytes
+static uint32_t reading_checksum(const PendingReading *reading) {
+    const unsigned char *bytes = (const unsigned char *)reading;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(*reading); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int write_record(FILE *f, const PendingReading *reading) {
+    JournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.reading = *reading;
+    record.checksum = reading_checksum(&record.reading);
+    return fwrite(&record, sizeof(record), 1, f) == 1;
+}
+
+// A record is replayed only if it is intact and continues the sequence
+static int record_valid(const JournalRecord *record, long long after_seq) {
+    const PendingReading *r = &record->reading;
+    return record->checksum == reading_checksum(r) &&
+           memchr(r->timestamp, '\0', sizeof(r->timestamp)) != NULL &&
+           r->seq > after_seq && r->gen_us > 0;
+}
+
+static void sync_journal(SensorWriter *writer) {
+    fsync(fileno(writer->journal));
+    writer->journal_synced_us = trace_now_us();
+    writer->journal_unsynced = 0;
+}
+
+static void spill(SensorWriter *writer, const PendingReading *reading) {
+    if (open_journal(writer) != 0 ||
+        fseek(writer->journal, 0, SEEK_END) != 0 ||
+        !write_record(writer->journal, reading) ||
+        fflush(writer->journal) != 0) {
+        fprintf(stderr, "Failed to journal reading %lld\n", reading->seq);
+        writer->stats.failed++;
+        return;
+    }
+    writer->journal_unsynced = 1;
+    if (trace_now_us() - writer->journal_synced_us >= WRITER_JOURNAL_SYNC_US) sync_journal(writer);
+
+    writer->journal_records++;
+    writer->journal_last_seq = reading->seq;
+    writer->stats.spilled++;
+}
+
+// Read the next journal records, keeping the valid ones in `rows`. *consumed is the number
+// of records read (valid or not); 0 means the journal couldn't be read.
+static int read_journal(SensorWriter *writer, PendingReading *rows, int max_rows, int *consumed) {
+    JournalRecord records[WRITER_BATCH_SIZE];
+    long long remaining = journal_pending(writer);
+    int count = remaining < max_rows ? (int)remaining : max_rows;
+    int valid = 0;
+
+    *consumed = 0;
+    if (count > WRITER_BATCH_SIZE) count = WRITER_BATCH_SIZE;
+    if (fseek(writer->journal, (long)(writer->journal_replayed * sizeof(JournalRecord)), SEEK_SET) != 0) {
+        return 0;
+    }
+    *consumed = (int)fread(records, sizeof(JournalRecord), count, writer->journal);
+
+    long long last_seq = writer->last_written_seq;
+    for (int i = 0; i < *consumed; i++) {
+        if (!record_valid(&records[i], last_seq)) {
+            writer->stats.corrupt++;
+            continue;
+        }
+        rows[valid++] = records[i].reading;
+        last_seq = records[i].reading.seq;
+    }
+    if (valid < *consumed) {
+        fprintf(stderr, "Skipped %d invalid records in %s\n", *consumed - valid, writer->journal_path);
+    }
+    return valid;
+}
+
+int writer_open(SensorWriter *writer, sqlite3 *db, const char *journal_path) {
+    memset(writer, 0, sizeof(*writer));
+    sketch_init(&writer->stats.gen_to_commit);
+    rollup_init(&writer->rollup, -1);
+    writer->db = db;
+    snprintf(writer->journal_path, sizeof(writer->journal_path), "%s", journal_path);
+
+    // Let SQLite wait out short locks itself before we fall back to backing off
+    sqlite3_busy_timeout(db, WRITER_BUSY_TIMEOUT_MS);
+    if (rollup_create_table(db) != 0) return -1;
+
+    const char *insert_sql =
+        "INSERT INTO sensor_readings (timestamp, temperature, humidity, illuminance, "
+        "seq, gen_time_us, insert_time_us) VALUES (?, ?, ?, ?, ?, ?, ?);";
+    if (sqlite3_prepare_v2(db, insert_sql, -1, &writer->insert_stmt, 0) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare insert: %s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    // Readings already in the database are never replayed again
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db, "SELECT MAX(seq) FROM sensor_readings;", -1, &stmt, 0) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) writer->last_written_seq = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+
+    // Pick up readings a previous run couldn't write
+    FILE *existing = fopen(journal_path, "rb");
+    if (!existing) return 0;
+    fclose(existing);
+    if (open_journal(writer) != 0) return -1;
+
+    fseek(writer->journal, 0, SEEK_END);
+    long size = ftell(writer->journal);
+    writer->journal_records = size > 0 ? size / (long)sizeof(JournalRecord) : 0;
+
+    // A crash mid-append leaves a partial record; cut it off so new records stay aligned
+    if (size > 0 && size % (long)sizeof(JournalRecord) != 0) {
+        if (ftruncate(fileno(writer->journal), (off_t)(writer->journal_records * sizeof(JournalRecord))) != 0) {
+            perror("Failed to repair write journal");
+            return -1;
+        }
+        fprintf(stderr, "Discarded a torn record at the end of %s\n", journal_path);
+    }
+    if (writer->journal_records == 0) {
+        discard_journal(writer);
+        return 0;
+    }
+
+    // Skip records committed before the journal could be discarded, and find the highest
+    // valid seq so the sequence continues after it
+    JournalRecord record;
+    long long valid = 0;
+    int skipping = 1;
+    writer->journal_last_seq = writer->last_written_seq;
+    fseek(writer->journal, 0, SEEK_SET);
+    for (long long i = 0; i < writer->journal_records &&
+                          fread(&record, sizeof(record), 1, writer->journal) == 1; i++) {
+        if (skipping && record.checksum == reading_checksum(&record.reading) &&
+            record.reading.seq <= writer->last_written_seq) {
+            writer->journal_replayed++;
+            continue;
+        }
+        skipping = 0;
+        if (record_valid(&record, writer->journal_last_seq)) {
+            writer->journal_last_seq = record.reading.seq;
+            valid++;
+        }
+    }
+
+    if (journal_pending(writer) == 0) {
+        discard_journal(writer);
+    } else {
+        printf("Replaying %lld journaled readings from %s (%lld invalid)\n",
+               valid, journal_path, journal_pending(writer) - valid);
+    }
+    return 0;
+}
+
+void writer_submit(SensorWriter *writer, const PendingReading *reading) {
+    // Once anything is journaled, newer readings queue behind it on disk to keep the order
+    if (journal_pending(writer) > 0 || writer->queue_depth == WRITER_QUEUE_CAPACITY) {
+        spill(writer, reading);
+    } else {
+        int tail = (writer->queue_head + writer->queue_depth) % WRITER_QUEUE_CAPACITY;
+        writer->queue[tail] = *reading;
+        writer->queue_depth++;
+        if (writer->queue_depth > writer->stats.max_depth) writer->stats.max_depth = writer->queue_depth;
+    }
+    writer_flush(writer);
+}
+
+long long writer_flush(SensorWriter *writer) {
+    long long now = trace_now_us();
+    if (writer->journal && writer->journal_unsynced && now - writer->journal_synced_us >= WRITER_JOURNAL_SYNC_US) {
+        sync_journal(writer);
+    }
+    if (writer_pending(writer) == 0 || now < writer->next_attempt_us) return writer_pending(writer);
+
+    // One batch per call: the queue first (it is always older), then the journal
+    PendingReading batch[WRITER_BATCH_SIZE];
+    int from_queue = writer->queue_depth > 0;
+    int count = 0, consumed = 0;
+
+    if (from_queue) {
+        while (count < WRITER_BATCH_SIZE && count < writer->queue_depth) {
+            batch[count] = writer->queue[(writer->queue_head + count) % WRITER_QUEUE_CAPACITY];
+            count++;
+        }
+    } else {
+        count = read_journal(writer, batch, WRITER_BATCH_SIZE, &consumed);
+        if (consumed == 0) {
+            fprintf(stderr, "Write journal %s is unreadable, %lld readings lost\n",
+                    writer->journal_path, journal_pending(writer));
+            writer->stats.failed += journal_pending(writer);
+            discard_journal(writer);
+            return writer_pending(writer);
+        }
+        if (count == 0) {
+            // Nothing valid in this stretch of the journal
+            writer->journal_replayed += consumed;
+            if (journal_pending(writer) == 0) discard_journal(writer);
+            return writer_pending(writer);
+        }
+    }
+
+    int failed;
+    int rc = insert_rows(writer, batch, count, &failed);
+    if (rc != SQLITE_OK) {
+        // Back off exponentially while the database stays locked
+        writer->stats.retries++;
+        writer->backoff_us = writer->backoff_us > 0 ? writer->backoff_us * 2 : WRITER_MIN_BACKOFF_US;
+        if (writer->backoff_us > WRITER_MAX_BACKOFF_US) writer->backoff_us = WRITER_MAX_BACKOFF_US;
+        writer->next_attempt_us = now + writer->backoff_us;
+        return writer_pending(writer);
+    }
+
+    // Ease off the backoff rather than resetting it, so sustained contention stays spaced out
+    writer->backoff_us /= 2;
+    if (writer->backoff_us < WRITER_MIN_BACKOFF_US) writer->backoff_us = 0;
+    writer->next_attempt_us = 0;
+
+    writer->stats.written += count - failed;
+    writer->stats.failed += failed;
+    if (batch[count - 1].seq > writer->last_written_seq) writer->last_written_seq = batch[count - 1].seq;
+    if (from_queue) {
+        writer->queue_head = (writer->queue_head + count) % WRITER_QUEUE_CAPACITY;
+        writer->queue_depth -= count;
+    } else {
+        writer->journal_replayed += consumed;
+        writer->stats.replayed += count - failed;
+        if (journal_pending(writer) == 0) discard_journal(writer);
+    }
+    return writer_pending(writer);
+}
+
+long long writer_pending(const SensorWriter *writer) {
+    return writer->queue_depth + journal_pending(writer);
+}
+
+long long writer_next_attempt_us(const SensorWriter *writer) {
+    return writer->next_attempt_us;
+}
+
+void writer_close(SensorWriter *writer) {
+    if (writer->queue_depth > 0) {
+        // The queue is older than anything journaled, so rewrite the journal with it in front
+        char tmp_path[520];
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", writer->journal_path);
+        FILE *out = fopen(tmp_path, "wb");
+        int ok = out != NULL;
+        long long saved = 0;
+
+        for (int i = 0; ok && i < writer->queue_depth; i++) {
+            ok = write_record(out, &writer->queue[(writer->queue_head + i) % WRITER_QUEUE_CAPACITY]);
+            saved++;
+        }
+        PendingReading batch[WRITER_BATCH_SIZE];
+        while (ok && writer->journal && journal_pending(writer) > 0) {
+            int consumed;
+            int count = read_journal(writer, batch, WRITER_BATCH_SIZE, &consumed);
+            if (consumed == 0) break;
+            for (int i = 0; ok && i < count; i++) {
+                ok = write_record(out, &batch[i]);
+            }
+            writer->journal_replayed += consumed;
+            saved += count;
+        }
+        if (out && (fflush(out) != 0 || fsync(fileno(out)) != 0)) ok = 0;
+        if (out && fclose(out) != 0) ok = 0;
+
+        if (writer->journal) fclose(writer->journal);
+        writer->journal = NULL;
+        if (ok && rename(tmp_path, writer->journal_path) == 0) {
+            writer->stats.spilled += writer->queue_depth;
+            writer->journal_records = saved;
+            writer->journal_replayed = 0;
+            printf("Saved %lld unwritten readings to %s\n", saved, writer->journal_path);
+        } else {
+            fprintf(stderr, "Failed to save %d unwritten readings to %s\n",
+                    writer->queue_depth, writer->journal_path);
+            writer->stats.failed += writer->queue_depth;
+            remove(tmp_path);
+        }
+        writer->queue_depth = 0;
+    } else if (writer->journal) {
+        sync_journal(writer);
+        fclose(writer->journal);
+        writer->journal = NULL;
+    }
+
+    sqlite3_finalize(writer->insert_stmt);
+    writer->insert_stmt = NULL;
+}
+
+void writer_report(const SensorWriter *writer, FILE *out) {
+    fprintf(out, "Writer: %lld written, %d queued (max %d), %lld journaled, "
+            "%lld spilled, %lld replayed, %lld retries, %lld failed, %lld corrupt\n",
+            writer->stats.written, writer->queue_depth, writer->stats.max_depth, journal_pending(writer),
+            writer->stats.spilled, writer->stats.replayed, writer->stats.retries, writer->stats.failed,
+            writer->stats.corrupt);
+    if (writer->stats.gen_to_commit.count > 0) {
+        const QuantileSketch *latency = &writer->stats.gen_to_commit;
+        fprintf(out, "  generate->commit p50 %9.1f ms   p95 %9.1f ms   p99 %9.1f ms\n",
+                sketch_quantile(latency, 0.50f), sketch_quantile(latency, 0.95f), sketch_quantile(latency, 0.99f));
+    }
+}
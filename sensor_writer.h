@@ -0,0 +1,87 @@
+#ifndef SENSOR_WRITER_H
+#define SENSOR_WRITER_H
+
+#include <stdio.h>
+#include <sqlite3.h>
+#include "quantile_sketch.h"
+#include "sensor_rollup.h"
+
+#define WRITER_QUEUE_CAPACITY 1024      // Readings buffered in memory before spilling to the journal
+#define WRITER_BATCH_SIZE 256           // Readings inserted per transaction while catching up
+#define WRITER_BUSY_TIMEOUT_MS 250      // SQLite's own wait on a locked database, per attempt
+#define WRITER_MIN_BACKOFF_US 10000LL
+#define WRITER_MAX_BACKOFF_US 2000000LL
+#define WRITER_JOURNAL_SYNC_US 100000LL // fsync the journal at most this often while spilling
+
+// One reading waiting to be written (stored in the journal with a checksum)
+typedef struct {
+    char timestamp[20];
+    float temperature;
+    float humidity;
+    float illuminance;
+    long long seq;
+    long long gen_us;
+} PendingReading;
+
+typedef struct {
+    long long written;              // Rows inserted
+    long long retries;              // Attempts that hit a busy/locked database
+    long long spilled;              // Readings appended to the journal
+    long long replayed;             // Journal readings inserted into the database
+    long long failed;               // Readings dropped on non-transient SQL or journal errors
+    long long corrupt;              // Journal records discarded as torn, corrupt or out of order
+    int max_depth;                  // Deepest the in-memory queue has been
+    QuantileSketch gen_to_commit;   // Generation until the row's COMMIT returned, in ms
+} WriterStats;
+
+// Buffers readings in a bounded queue and retries busy inserts with adaptive backoff.
+// When the queue is full, new readings go to an append-only journal file until it has been
+// replayed, so rows always reach the database in the order they were generated. Every
+// transaction also updates the rows' buckets in sensor_rollups.
+//
+// Durability: lock contention and clean shutdowns lose nothing. If the process dies, the
+// in-memory queue (up to WRITER_QUEUE_CAPACITY readings) is lost; journaled readings survive,
+// and after a power loss at most the last WRITER_JOURNAL_SYNC_US of journal appends are lost.
+typedef struct {
+    sqlite3 *db;
+    sqlite3_stmt *insert_stmt;
+    PendingReading queue[WRITER_QUEUE_CAPACITY];
+    int queue_head;
+    int queue_depth;
+    FILE *journal;
+    char journal_path[512];
+    long long journal_records;      // Whole records in the journal file
+    long long journal_replayed;     // Of those, already inserted
+    long long journal_last_seq;     // Highest seq in the journal (continues the sequence on restart)
+    long long journal_synced_us;    // Last fsync of the journal
+    int journal_unsynced;           // Appends since that fsync
+    long long last_written_seq;     // Highest seq in the database; journal records must exceed it
+    long long backoff_us;
+    long long next_attempt_us;
+    RollupBucket rollup;            // Bucket being filled, as of the last commit
+    WriterStats stats;
+} SensorWriter;
+
+// Prepares the insert and opens the journal, picking up readings left by a previous run.
+// Returns 0 on success, -1 on failure.
+int writer_open(SensorWriter *writer, sqlite3 *db, const char *journal_path);
+
+// Queues a reading (or spills it to the journal) and tries to flush
+void writer_submit(SensorWriter *writer, const PendingReading *reading);
+
+// Writes as much of the backlog as the database accepts, unless backing off.
+// Returns the number of readings still pending.
+long long writer_flush(SensorWriter *writer);
+
+// Readings not yet in the database
+long long writer_pending(const SensorWriter *writer);
+
+// Time of the next write attempt, for sleeping between readings
+long long writer_next_attempt_us(const SensorWriter *writer);
+
+// Spills anything still queued to the journal and releases the statement
+void writer_close(SensorWriter *writer);
+
+void writer_report(const SensorWriter *writer, FILE *out);
+
+#endif // SENSOR_WRITER_H
@@ -0,0 +1,47 @@
+#include <math.h>
+#include <gsl/gsl_math.h>
+#include <gsl/gsl_fft_real.h>
+#include "sliding_dft.h"
+
+int sdft_seed(SlidingDft *sdft, const float *samples, int window) {
+    double data[SDFT_MAX_WINDOW];
+
+    if (window < 2 || window > SDFT_MAX_WINDOW || (window & (window - 1)) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < window; i++) data[i] = samples[i];
+    gsl_fft_real_radix2_transform(data, 1, window);
+
+    sdft->window = window;
+    sdft->bins = window / 2 + 1;
+
+    // Unpack GSL's half-complex layout: data[k] = Re(k), data[N-k] = Im(k)
+    for (int k = 0; k < sdft->bins; k++) {
+        sdft->re[k] = data[k];
+        sdft->im[k] = (k == 0 || k == window / 2) ? 0.0 : data[window - k];
+
+        double angle = 2.0 * M_PI * k / window;
+        sdft->twiddle_re[k] = cos(angle);
+        sdft->twiddle_im[k] = sin(angle);
+    }
+    return 0;
+}
+
+void sdft_update(SlidingDft *sdft, float newest, float oldest) {
+    double delta = (double)newest - oldest;
+
+    // X_k <- (X_k - x_old + x_new) * e^(j*2*pi*k/N)
+    for (int k = 0; k < sdft->bins; k++) {
+        double re = sdft->re[k] + delta;
+        double im = sdft->im[k];
+        sdft->re[k] = re * sdft->twiddle_re[k] - im * sdft->twiddle_im[k];
+        sdft->im[k] = re * sdft->twiddle_im[k] + im * sdft->twiddle_re[k];
+    }
+}
+
+float sdft_amplitude(const SlidingDft *sdft, int bin) {
+    double magnitude = sqrt(sdft->re[bin] * sdft->re[bin] + sdft->im[bin] * sdft->im[bin]);
+    double scale = (bin == 0 || bin == sdft->window / 2) ? 1.0 : 2.0;
+    return (float)(scale * magnitude / sdft->window);
+}
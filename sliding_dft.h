@@ -0,0 +1,30 @@
+#ifndef SLIDING_DFT_H
+#define SLIDING_DFT_H
+
+// Sliding DFT: keeps all N/2+1 bins of the DFT over the last N samples and updates each
+// bin in O(1) per new sample. A full FFT is only needed to (re)seed the bins, e.g. when
+// the window size changes.
+#define SDFT_MAX_WINDOW 256
+#define SDFT_MAX_BINS (SDFT_MAX_WINDOW / 2 + 1)
+
+typedef struct {
+    int window;                         // N, a power of two <= SDFT_MAX_WINDOW
+    int bins;                           // N/2 + 1
+    double re[SDFT_MAX_BINS];
+    double im[SDFT_MAX_BINS];
+    double twiddle_re[SDFT_MAX_BINS];   // e^(j*2*pi*k/N)
+    double twiddle_im[SDFT_MAX_BINS];
+} SlidingDft;
+
+// Seed from the last `window` samples (oldest first) with a GSL FFT.
+// Returns 0 on success, -1 if the window size is not a supported power of two.
+int sdft_seed(SlidingDft *sdft, const float *samples, int window);
+
+// Slide the window by one sample: `newest` enters, `oldest` (the sample N positions
+// earlier) leaves
+void sdft_update(SlidingDft *sdft, float newest, float oldest);
+
+// Single-sided amplitude of a bin (2|X_k|/N, |X_0|/N for DC)
+float sdft_amplitude(const SlidingDft *sdft, int bin);
+
+#endif